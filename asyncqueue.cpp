@@ -0,0 +1,230 @@
+
+#include "asyncqueue.h"
+
+// Executor constructor: an empty run queue
+Executor::Executor() {
+    m_stopped = false;
+}
+
+// Queues a coroutine to be resumed and wakes a thread sleeping in run()
+void Executor::schedule(coroutine_handle<> handle) {
+    {
+        lock_guard<mutex> guard(m_lock);
+        m_runQueue.push_back(handle);
+    }
+    m_ready.notify_one();
+}
+
+// Resumes the coroutines that are ready, including the ones they schedule, without waiting
+int Executor::runPending() {
+    int resumed = 0;
+    while (true){
+        coroutine_handle<> handle;
+        {
+            lock_guard<mutex> guard(m_lock);
+            if (m_runQueue.empty())
+                return resumed;
+            handle = m_runQueue.front();
+            m_runQueue.pop_front();
+        }
+        handle.resume();
+        resumed++;
+    }
+}
+
+// Resumes coroutines as they become ready; returns after stop() once the run queue is empty
+void Executor::run() {
+    while (true){
+        coroutine_handle<> handle;
+        {
+            unique_lock<mutex> guard(m_lock);
+            m_ready.wait(guard, [this]{ return m_stopped || !m_runQueue.empty(); });
+            if (m_runQueue.empty())
+                return;
+            handle = m_runQueue.front();
+            m_runQueue.pop_front();
+        }
+        handle.resume();
+    }
+}
+
+// Makes run() return once nothing is left to resume
+void Executor::stop() {
+    {
+        lock_guard<mutex> guard(m_lock);
+        m_stopped = true;
+    }
+    m_ready.notify_all();
+}
+
+// AsyncQueue constructor: producers wait once the queue holds highWater posts (0: never)
+AsyncQueue::AsyncQueue(prifn_t priFn, HEAPTYPE heapType, STRUCTURE structure, Executor& executor, int highWater)
+    : m_queue(priFn, heapType, structure), m_executor(executor) {
+    if (highWater < 0)
+        throw out_of_range("Invalid high-water mark");
+    m_highWater = highWater;
+    m_closed = false;
+}
+
+// Awaiter of the highest priority post
+AsyncQueue::NextAwaiter AsyncQueue::next() {
+    return NextAwaiter(*this);
+}
+
+// Awaiter of between 1 and k posts
+AsyncQueue::TakeAwaiter AsyncQueue::nextBatch(int k) {
+    if (k < 1)
+        throw out_of_range("Invalid batch size");
+    return TakeAwaiter(*this, k);
+}
+
+// Awaiter of inserting a post
+AsyncQueue::PushAwaiter AsyncQueue::push(const Post& post) {
+    return PushAwaiter(*this, post);
+}
+
+// Takes the posts now, or registers the consumer and suspends while the queue is empty
+bool AsyncQueue::TakeAwaiter::await_suspend(coroutine_handle<> handle) {
+    vector< coroutine_handle<> > ready;
+    {
+        lock_guard<mutex> guard(m_queue.m_lock);
+        if (m_queue.m_queue.numPosts() == 0){
+            if (m_queue.m_closed)
+                return false;
+            m_handle = handle;
+            m_queue.m_consumers.push_back(this);
+            return true;
+        }
+        m_queue.take(*this);
+        m_queue.dispatch(ready); // the room made may let producers in
+    }
+    m_queue.wake(ready);
+    return false;
+}
+
+// The post taken, or nothing if the queue was closed and empty
+optional<Post> AsyncQueue::NextAwaiter::await_resume() {
+    vector<Post> posts = TakeAwaiter::await_resume();
+    if (posts.empty())
+        return nullopt;
+    return posts[0];
+}
+
+// Inserts the post now, or registers the producer and suspends while the queue is full
+bool AsyncQueue::PushAwaiter::await_suspend(coroutine_handle<> handle) {
+    vector< coroutine_handle<> > ready;
+    {
+        lock_guard<mutex> guard(m_queue.m_lock);
+        if (m_queue.m_closed)
+            return false;
+        if (m_queue.isFull() || !m_queue.m_producers.empty()){ // earlier producers go first
+            m_handle = handle;
+            m_queue.m_producers.push_back(this);
+            return true;
+        }
+        m_accepted = m_queue.m_queue.insertPost(m_post);
+        m_queue.dispatch(ready);
+    }
+    m_queue.wake(ready);
+    return false;
+}
+
+// Inserts a post regardless of the high-water mark; false if it is invalid or the queue is closed
+bool AsyncQueue::insertPost(const Post& post) {
+    vector< coroutine_handle<> > ready;
+    bool inserted;
+    {
+        lock_guard<mutex> guard(m_lock);
+        if (m_closed)
+            return false;
+        inserted = m_queue.insertPost(post);
+        dispatch(ready);
+    }
+    wake(ready);
+    return inserted;
+}
+
+// Takes the highest priority post if there is one; never throws on an empty queue
+bool AsyncQueue::tryNext(Post& post) {
+    vector< coroutine_handle<> > ready;
+    {
+        lock_guard<mutex> guard(m_lock);
+        if (m_queue.numPosts() == 0)
+            return false;
+        post = m_queue.getNextPost();
+        dispatch(ready);
+    }
+    wake(ready);
+    return true;
+}
+
+// Refuses further posts and resumes every waiting producer and consumer
+void AsyncQueue::close() {
+    vector< coroutine_handle<> > ready;
+    {
+        lock_guard<mutex> guard(m_lock);
+        m_closed = true;
+        dispatch(ready);
+    }
+    wake(ready);
+}
+
+bool AsyncQueue::isClosed() const {
+    lock_guard<mutex> guard(m_lock);
+    return m_closed;
+}
+
+int AsyncQueue::numPosts() const {
+    lock_guard<mutex> guard(m_lock);
+    return m_queue.numPosts();
+}
+
+// Whether producers have to wait; called with the lock held
+bool AsyncQueue::isFull() const {
+    return m_highWater > 0 && m_queue.numPosts() >= m_highWater;
+}
+
+// Moves up to the consumer's count of posts into it; called with the lock held
+void AsyncQueue::take(TakeAwaiter& consumer) {
+    while ((int)consumer.m_posts.size() < consumer.m_count && m_queue.numPosts() > 0)
+        consumer.m_posts.push_back(m_queue.getNextPost());
+}
+
+// Hands posts to waiting consumers and room to waiting producers until neither
+// can progress; the coroutines to resume are collected in ready. Called with the lock held
+void AsyncQueue::dispatch(vector< coroutine_handle<> >& ready) {
+    bool progress = true;
+    while (progress){
+        progress = false;
+        while (!m_consumers.empty() && m_queue.numPosts() > 0){
+            TakeAwaiter* consumer = m_consumers.front();
+            m_consumers.pop_front();
+            take(*consumer);
+            ready.push_back(consumer->m_handle);
+            progress = true;
+        }
+        while (!m_closed && !m_producers.empty() && !isFull()){
+            PushAwaiter* producer = m_producers.front();
+            m_producers.pop_front();
+            producer->m_accepted = m_queue.insertPost(producer->m_post);
+            ready.push_back(producer->m_handle);
+            progress = true;
+        }
+    }
+    if (m_closed){
+        // Nothing more will arrive: waiting consumers (the queue is empty) get no posts
+        // and waiting producers are refused
+        for (size_t i = 0; i < m_consumers.size(); i++)
+            ready.push_back(m_consumers[i]->m_handle);
+        m_consumers.clear();
+        for (size_t i = 0; i < m_producers.size(); i++)
+            ready.push_back(m_producers[i]->m_handle);
+        m_producers.clear();
+    }
+}
+
+// Schedules the coroutines dispatch() made ready; called without the lock
+void AsyncQueue::wake(const vector< coroutine_handle<> >& ready) {
+    for (size_t i = 0; i < ready.size(); i++)
+        m_executor.schedule(ready[i]);
+}
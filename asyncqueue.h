@@ -0,0 +1,119 @@
+#ifndef ASYNCQUEUE_H
+#define ASYNCQUEUE_H
+// Requires C++20 (coroutines), e.g. g++ -std=c++20
+#include "squeue.h"
+#include <coroutine>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <vector>
+using namespace std;
+class Tester;   // forward declaration (for testing purposes)
+
+// A local executor: a run queue of suspended coroutines that are ready to go on.
+// Any thread may schedule a coroutine; they are resumed by whichever thread calls
+// run() or runPending()
+class Executor{
+    public:
+    Executor();
+    Executor(const Executor& rhs) = delete;
+    Executor& operator=(const Executor& rhs) = delete;
+    void schedule(coroutine_handle<> handle); // Queues a coroutine to be resumed
+    int runPending(); // Resumes the ready coroutines without waiting; returns how many
+    void run(); // Resumes coroutines, sleeping while none is ready, until stop()
+    void stop(); // Makes run() return once the run queue is empty
+
+    private:
+    mutex m_lock;
+    condition_variable m_ready;
+    deque< coroutine_handle<> > m_runQueue;
+    bool m_stopped;
+};
+
+// Fire-and-forget coroutine: it starts running right away and frees itself at
+// the end. Consumers and producers are written as functions returning AsyncTask
+struct AsyncTask{
+    struct promise_type{
+        AsyncTask get_return_object(){ return AsyncTask(); }
+        suspend_never initial_suspend() noexcept { return suspend_never(); }
+        suspend_never final_suspend() noexcept { return suspend_never(); }
+        void return_void(){}
+        void unhandled_exception(){ terminate(); }
+    };
+};
+
+// An SQueue for coroutines. Consumers co_await next() or nextBatch(k) and are
+// suspended, not spinning, while the queue is empty; a post that arrives while
+// a consumer waits is handed to it directly and the consumer is scheduled on the
+// executor. Producers co_await push(post) and are suspended while the queue
+// holds highWater posts or more (0: unbounded). close() wakes everyone; after it
+// the consumers get the remaining posts and then nothing
+class AsyncQueue{
+    public:
+    friend class Tester; // for testing purposes
+
+    // Awaiter of next() and nextBatch(k): resumes with up to k posts, none once
+    // the queue is closed and empty
+    class TakeAwaiter{
+        public:
+        TakeAwaiter(AsyncQueue& queue, int count) : m_queue(queue), m_count(count) {}
+        bool await_ready() const { return false; }
+        bool await_suspend(coroutine_handle<> handle);
+        vector<Post> await_resume() { return std::move(m_posts); }
+        private:
+        friend class AsyncQueue;
+        AsyncQueue& m_queue;
+        int m_count;
+        vector<Post> m_posts;
+        coroutine_handle<> m_handle;
+    };
+    // Awaiter of next(): one post, or nothing once the queue is closed and empty
+    class NextAwaiter : public TakeAwaiter{
+        public:
+        NextAwaiter(AsyncQueue& queue) : TakeAwaiter(queue, 1) {}
+        optional<Post> await_resume();
+    };
+    // Awaiter of push(post): resumes with false if the queue was closed first
+    class PushAwaiter{
+        public:
+        PushAwaiter(AsyncQueue& queue, const Post& post) : m_queue(queue), m_post(post), m_accepted(false) {}
+        bool await_ready() const { return false; }
+        bool await_suspend(coroutine_handle<> handle);
+        bool await_resume() const { return m_accepted; }
+        private:
+        friend class AsyncQueue;
+        AsyncQueue& m_queue;
+        Post m_post;
+        bool m_accepted;
+        coroutine_handle<> m_handle;
+    };
+
+    AsyncQueue(prifn_t priFn, HEAPTYPE heapType, STRUCTURE structure, Executor& executor, int highWater = 0);
+    AsyncQueue(const AsyncQueue& rhs) = delete; // waiters point to the queue
+    AsyncQueue& operator=(const AsyncQueue& rhs) = delete;
+    NextAwaiter next(); // co_await: the highest priority post
+    TakeAwaiter nextBatch(int k); // co_await: between 1 and k posts in priority order
+    PushAwaiter push(const Post& post); // co_await: inserts, waiting below the high-water mark
+    bool insertPost(const Post& post); // Inserts without waiting, for producers outside coroutines
+    bool tryNext(Post& post); // Takes the highest priority post if there is one, without throwing
+    void close();
+    bool isClosed() const;
+    int numPosts() const;
+
+    private:
+    SQueue m_queue;
+    Executor& m_executor;
+    int m_highWater;            // producers wait while the queue holds this many posts
+    bool m_closed;
+    mutable mutex m_lock;       // guards everything above
+    deque<TakeAwaiter*> m_consumers;    // suspended consumers, oldest first
+    deque<PushAwaiter*> m_producers;    // suspended producers, oldest first
+
+    bool isFull() const;
+    void take(TakeAwaiter& consumer);
+    void dispatch(vector< coroutine_handle<> >& ready);
+    void wake(const vector< coroutine_handle<> >& ready);
+};
+#endif
@@ -0,0 +1,178 @@
+
+#include "boundedsqueue.h"
+
+// BoundedSQueue constructor: an empty queue holding at most capacity posts
+BoundedSQueue::BoundedSQueue(prifn_t priFn, HEAPTYPE heapType, int capacity) {
+    if (capacity < 1)
+        throw out_of_range("Invalid capacity");
+    m_priorFunc = priFn;
+    m_heapType = heapType;
+    m_capacity = capacity;
+    m_evicted = 0;
+    m_heap.reserve(capacity);
+}
+
+// Inserts a post; a full queue evicts its worst post, or rejects the new one if it is not better
+bool BoundedSQueue::insertPost(const Post& post) {
+    int priority = m_priorFunc(post);
+    if (priority == 0) // Invalid priority, as for SQueue::insertPost
+        return false;
+    Entry entry;
+    entry.m_payload = post.getPayload();
+    entry.m_rank = (m_heapType == MAXHEAP) ? priority : -priority;
+
+    if ((int)m_heap.size() >= m_capacity){
+        m_evicted++;
+        if (entry.m_rank <= m_heap[0].m_rank) // On a tie the older post stays
+            return false;
+        m_heap[0] = entry; // Replace the worst post in place
+        pushDown(0);
+        return true;
+    }
+    m_heap.push_back(entry);
+    pushUp((int)m_heap.size() - 1);
+    return true;
+}
+
+// Removes and returns the highest priority post
+Post BoundedSQueue::getNextPost() {
+    if (m_heap.empty())
+        throw out_of_range("Empty Queue");
+    int best = bestIndex();
+    Post post(m_heap[best].m_payload);
+    removeAt(best);
+    return post;
+}
+
+// Removes and returns the lowest priority post
+Post BoundedSQueue::getWorstPost() {
+    if (m_heap.empty())
+        throw out_of_range("Empty Queue");
+    Post post(m_heap[0].m_payload);
+    removeAt(0);
+    return post;
+}
+
+// Returns the highest priority post without removing it
+Post BoundedSQueue::peekNextPost() const {
+    if (m_heap.empty())
+        throw out_of_range("Empty Queue");
+    return Post(m_heap[bestIndex()].m_payload);
+}
+
+// Returns the lowest priority post without removing it
+Post BoundedSQueue::peekWorstPost() const {
+    if (m_heap.empty())
+        throw out_of_range("Empty Queue");
+    return Post(m_heap[0].m_payload);
+}
+
+int BoundedSQueue::numPosts() const {
+    return (int)m_heap.size();
+}
+
+int BoundedSQueue::getCapacity() const {
+    return m_capacity;
+}
+
+// Changes the capacity, evicting the worst posts that no longer fit
+void BoundedSQueue::setCapacity(int capacity) {
+    if (capacity < 1)
+        throw out_of_range("Invalid capacity");
+    m_capacity = capacity;
+    while ((int)m_heap.size() > m_capacity){
+        removeAt(0);
+        m_evicted++;
+    }
+}
+
+// Returns the number of posts evicted or rejected because the queue was full
+int BoundedSQueue::numEvicted() const {
+    return m_evicted;
+}
+
+// Removes every post; the capacity and the eviction count stay
+void BoundedSQueue::clear() {
+    m_heap.clear();
+}
+
+HEAPTYPE BoundedSQueue::getHeapType() const {
+    return m_heapType;
+}
+
+// Index of the best post: the larger of the root's children, or the root when it has none
+int BoundedSQueue::bestIndex() const {
+    if (m_heap.size() == 1)
+        return 0;
+    if (m_heap.size() == 2 || m_heap[1].m_rank >= m_heap[2].m_rank)
+        return 1;
+    return 2;
+}
+
+// Removes the post at index 0 (the worst) or at bestIndex() by moving the last post there
+void BoundedSQueue::removeAt(int index) {
+    m_heap[index] = m_heap.back();
+    m_heap.pop_back();
+    if (index < (int)m_heap.size())
+        pushDown(index);
+}
+
+// Moves a new post up: first to the right kind of level, then past worse
+// (min level) or better (max level) grandparents
+void BoundedSQueue::pushUp(int index) {
+    if (index == 0)
+        return;
+    bool minLevel = isMinLevel(index);
+    int parent = (index - 1) / 2;
+    if (minLevel ? m_heap[index].m_rank > m_heap[parent].m_rank : m_heap[index].m_rank < m_heap[parent].m_rank){
+        swap(m_heap[index], m_heap[parent]);
+        index = parent;
+        minLevel = !minLevel;
+    }
+    while (index > 2){
+        int grandparent = ((index - 1) / 2 - 1) / 2;
+        if (minLevel ? m_heap[index].m_rank < m_heap[grandparent].m_rank : m_heap[index].m_rank > m_heap[grandparent].m_rank){
+            swap(m_heap[index], m_heap[grandparent]);
+            index = grandparent;
+        }
+        else
+            break;
+    }
+}
+
+// Moves a post down to the lowest (min level) or highest (max level) of its
+// children and grandchildren, fixing the level in between after a grandchild swap
+void BoundedSQueue::pushDown(int index) {
+    bool minLevel = isMinLevel(index);
+    int size = (int)m_heap.size();
+    while (true){
+        int child = 2 * index + 1;
+        if (child >= size)
+            return;
+        // The most extreme of up to two children and four grandchildren
+        int extreme = child;
+        int candidates[] = {child + 1, 2 * child + 1, 2 * child + 2, 2 * child + 3, 2 * child + 4};
+        for (int i = 0; i < 5 && candidates[i] < size; i++){
+            int rank = m_heap[candidates[i]].m_rank;
+            if (minLevel ? rank < m_heap[extreme].m_rank : rank > m_heap[extreme].m_rank)
+                extreme = candidates[i];
+        }
+        if (minLevel ? m_heap[extreme].m_rank >= m_heap[index].m_rank : m_heap[extreme].m_rank <= m_heap[index].m_rank)
+            return;
+        swap(m_heap[index], m_heap[extreme]);
+        if (extreme <= child + 1) // A child: it is on the other kind of level and ends the walk
+            return;
+        int parent = (extreme - 1) / 2;
+        if (minLevel ? m_heap[extreme].m_rank > m_heap[parent].m_rank : m_heap[extreme].m_rank < m_heap[parent].m_rank)
+            swap(m_heap[extreme], m_heap[parent]);
+        index = extreme;
+    }
+}
+
+// Whether an index lies on an even level of the heap, which holds the worst post of its subtree
+bool BoundedSQueue::isMinLevel(int index) {
+    int level = 0;
+    for (index++; index > 1; index >>= 1)
+        level++;
+    return level % 2 == 0;
+}
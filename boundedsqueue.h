@@ -0,0 +1,50 @@
+#ifndef BOUNDEDSQUEUE_H
+#define BOUNDEDSQUEUE_H
+#include "squeue.h"
+#include <vector>
+using namespace std;
+class Tester;   // forward declaration (for testing purposes)
+
+// A post queue that holds at most capacity posts. Inserting into a full queue
+// evicts the worst post, or rejects the new one if it is not better than that.
+// The posts live in a min-max heap (an array whose even levels hold the worst
+// post of their subtree and whose odd levels hold the best), so both ends are
+// found in O(1) and removed in O(log n)
+class BoundedSQueue{
+    public:
+    friend class Tester; // for testing purposes
+
+    BoundedSQueue(prifn_t priFn, HEAPTYPE heapType, int capacity);
+    bool insertPost(const Post& post); // false if invalid or rejected by a full queue
+    Post getNextPost(); // Removes and returns the highest priority post
+    Post getWorstPost(); // Removes and returns the lowest priority post
+    Post peekNextPost() const;
+    Post peekWorstPost() const;
+    int numPosts() const;
+    int getCapacity() const;
+    void setCapacity(int capacity); // Evicts the worst posts down to the new capacity
+    int numEvicted() const; // Posts evicted or rejected because the queue was full
+    void clear();
+    HEAPTYPE getHeapType() const;
+
+    private:
+    // A post with its rank: the priority, negated for a MINHEAP, so that a higher
+    // rank is always a better post
+    struct Entry{
+        uint64_t m_payload;
+        int m_rank;
+    };
+
+    prifn_t m_priorFunc;    // Function to compute priority
+    HEAPTYPE m_heapType;    // either a MINHEAP or a MAXHEAP
+    int m_capacity;         // most posts the queue holds
+    int m_evicted;          // posts dropped because the queue was full
+    vector<Entry> m_heap;   // min-max heap of the posts
+
+    int bestIndex() const;
+    void removeAt(int index);
+    void pushUp(int index);
+    void pushDown(int index);
+    static bool isMinLevel(int index);
+};
+#endif
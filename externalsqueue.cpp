@@ -0,0 +1,245 @@
+
+#include "externalsqueue.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+const int RUNBLOCK = 1 << 16; // posts per disk read or write (512 KB)
+const int MERGEWAY = 16;      // runs of a level merged into one run of the next level
+const STRUCTURE FRONTSTRUCTURE = LEFTIST; // structure of the in-memory front
+
+// ExternalSQueue constructor: an empty queue spilling to directory
+ExternalSQueue::ExternalSQueue(prifn_t priFn, HEAPTYPE heapType, const string& directory, int memoryPosts)
+    : m_front(priFn, heapType, FRONTSTRUCTURE) {
+    if (memoryPosts < 1)
+        throw out_of_range("Invalid memory size");
+    m_priorFunc = priFn;
+    m_heapType = heapType;
+    m_directory = directory;
+    m_memoryPosts = memoryPosts;
+    m_size = 0;
+    m_bytesWritten = 0;
+    m_bytesRead = 0;
+}
+
+ExternalSQueue::~ExternalSQueue() {
+    clear();
+}
+
+// Inserts a post into the front, spilling the front once it is full
+bool ExternalSQueue::insertPost(const Post& post) {
+    if (!m_front.insertPost(post))
+        return false;
+    m_size++;
+    if (m_front.numPosts() >= m_memoryPosts)
+        spill();
+    return true;
+}
+
+// Removes the better of the front's root and the best run head. If the next
+// block of the run cannot be read, the run keeps its head and the pop can be retried
+Post ExternalSQueue::getNextPost() {
+    if (m_size == 0)
+        throw out_of_range("Empty Queue");
+    if (m_runs.empty() || (m_front.numPosts() > 0 && key(m_front.peekNextPost().getPayload()) < m_runs.front()->m_key)){
+        Post post = m_front.getNextPost();
+        m_size--;
+        return post;
+    }
+
+    pop_heap(m_runs.begin(), m_runs.end(), later);
+    Run* run = m_runs.back();
+    Post post(run->m_block[run->m_position]);
+    bool more;
+    try{
+        more = advance(run);
+    }
+    catch (...){
+        run->m_position--; // fill() leaves the block as it was
+        push_heap(m_runs.begin(), m_runs.end(), later);
+        throw;
+    }
+    if (more)
+        push_heap(m_runs.begin(), m_runs.end(), later);
+    else{
+        closeRun(run);
+        m_runs.pop_back();
+    }
+    m_size--;
+    return post;
+}
+
+long long ExternalSQueue::numPosts() const {
+    return m_size;
+}
+
+HEAPTYPE ExternalSQueue::getHeapType() const {
+    return m_heapType;
+}
+
+int ExternalSQueue::numRuns() const {
+    return (int)m_runs.size();
+}
+
+long long ExternalSQueue::getBytesWritten() const {
+    return m_bytesWritten;
+}
+
+long long ExternalSQueue::getBytesRead() const {
+    return m_bytesRead;
+}
+
+// Removes every post by closing the runs, which deletes their files. The front
+// is replaced by an empty one, since SQueue::clear() also resets its priority
+// function, heap type and structure
+void ExternalSQueue::clear() {
+    for (size_t i = 0; i < m_runs.size(); i++)
+        closeRun(m_runs[i]);
+    m_runs.clear();
+    m_front = SQueue(m_priorFunc, m_heapType, FRONTSTRUCTURE);
+    m_size = 0;
+}
+
+int ExternalSQueue::key(uint64_t payload) const {
+    int priority = m_priorFunc(Post(payload));
+    return (m_heapType == MAXHEAP) ? -priority : priority;
+}
+
+// Writes the front to a new run of level 0 in priority order, then merges full levels
+void ExternalSQueue::spill() {
+    Run* run = openRun(0);
+    vector<uint64_t> block;
+    block.reserve(RUNBLOCK);
+    while (m_front.numPosts() > 0){
+        block.push_back(m_front.getNextPost().getPayload());
+        if ((int)block.size() == RUNBLOCK)
+            writeBlock(run, block);
+    }
+    writeBlock(run, block);
+    fill(run);
+    m_runs.push_back(run);
+    push_heap(m_runs.begin(), m_runs.end(), later);
+    compact();
+}
+
+// Merges the runs of each level that has MERGEWAY of them into one run of the
+// next level, from level 0 up. Partly consumed runs merge what they have left
+void ExternalSQueue::compact() {
+    for (int level = 0; ; level++){
+        vector<Run*> group, rest;
+        for (size_t i = 0; i < m_runs.size(); i++)
+            (m_runs[i]->m_level == level ? group : rest).push_back(m_runs[i]);
+        if ((int)group.size() < MERGEWAY)
+            return;
+
+        Run* merged = openRun(level + 1);
+        vector<uint64_t> block;
+        block.reserve(RUNBLOCK);
+        make_heap(group.begin(), group.end(), later);
+        while (!group.empty()){
+            pop_heap(group.begin(), group.end(), later);
+            Run* run = group.back();
+            block.push_back(run->m_block[run->m_position]);
+            if ((int)block.size() == RUNBLOCK)
+                writeBlock(merged, block);
+            if (advance(run))
+                push_heap(group.begin(), group.end(), later);
+            else{
+                closeRun(run);
+                group.pop_back();
+            }
+        }
+        writeBlock(merged, block);
+        fill(merged);
+        rest.push_back(merged);
+        m_runs.swap(rest);
+        make_heap(m_runs.begin(), m_runs.end(), later);
+    }
+}
+
+// Creates an empty run file in the directory and unlinks it right away
+ExternalSQueue::Run* ExternalSQueue::openRun(int level) {
+    string path = m_directory + "/squeue_run_XXXXXX";
+    vector<char> name(path.begin(), path.end());
+    name.push_back('\0');
+    int fd = mkstemp(name.data());
+    if (fd < 0)
+        throw runtime_error("mkstemp failed: " + string(strerror(errno)));
+    unlink(name.data());
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    Run* run = new Run;
+    run->m_fd = fd;
+    run->m_level = level;
+    run->m_length = 0;
+    run->m_read = 0;
+    run->m_position = 0;
+    run->m_key = 0;
+    return run;
+}
+
+// Appends a block of payloads to a run and empties the block
+void ExternalSQueue::writeBlock(Run* run, vector<uint64_t>& block) {
+    const char* data = (const char*)block.data();
+    size_t length = block.size() * sizeof(uint64_t);
+    while (length > 0){
+        ssize_t written = write(run->m_fd, data, length);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            throw runtime_error("Run write failed: " + string(strerror(errno)));
+        data += written;
+        length -= written;
+        m_bytesWritten += written;
+    }
+    run->m_length += block.size();
+    block.clear();
+}
+
+// Reads the next block of a run; false once the run is used up. The block is
+// replaced only once the read succeeded
+bool ExternalSQueue::fill(Run* run) {
+    long long count = min((long long)RUNBLOCK, run->m_length - run->m_read);
+    if (count <= 0)
+        return false;
+    vector<uint64_t> block(count);
+    char* data = (char*)block.data();
+    size_t length = count * sizeof(uint64_t);
+    off_t offset = run->m_read * sizeof(uint64_t);
+    while (length > 0){
+        ssize_t got = pread(run->m_fd, data, length, offset);
+        if (got < 0 && errno == EINTR)
+            continue;
+        if (got <= 0)
+            throw runtime_error("Run read failed: " + string(got < 0 ? strerror(errno) : "truncated run"));
+        data += got;
+        length -= got;
+        offset += got;
+        m_bytesRead += got;
+    }
+    run->m_block.swap(block);
+    run->m_read += count;
+    run->m_position = 0;
+    run->m_key = key(run->m_block[0]);
+    return true;
+}
+
+// Moves past the head of a run; false once the run is used up
+bool ExternalSQueue::advance(Run* run) {
+    if (++run->m_position < run->m_block.size()){
+        run->m_key = key(run->m_block[run->m_position]);
+        return true;
+    }
+    return fill(run);
+}
+
+void ExternalSQueue::closeRun(Run* run) {
+    close(run->m_fd);
+    delete run;
+}
+
+// Heap order of the runs: true if run1 has the worse head
+bool ExternalSQueue::later(const Run* run1, const Run* run2) {
+    return run1->m_key > run2->m_key;
+}
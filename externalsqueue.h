@@ -0,0 +1,70 @@
+#ifndef EXTERNALSQUEUE_H
+#define EXTERNALSQUEUE_H
+#include "squeue.h"
+#include <string>
+#include <vector>
+using namespace std;
+class Tester;   // forward declaration (for testing purposes)
+
+// A post queue for more posts than fit in memory, organized as a sequence heap.
+// Inserts go to an in-memory SQueue front; once it holds memoryPosts posts it is
+// drained in priority order into a sorted run on local disk. Runs of a level are
+// merged MERGEWAY at a time into one run of the next level, so a post is written
+// O(log(n / memoryPosts) / log MERGEWAY) times. A pop takes the better of the
+// front's root and the best run head, found with a small heap of runs.
+// Runs are written and read sequentially in blocks of RUNBLOCK posts (write and
+// pread with a sequential access hint), so memory holds the front plus one block
+// per run. Run files are unlinked as soon as they are created: they vanish with
+// the queue, or with the process if it dies
+class ExternalSQueue{
+    public:
+    friend class Tester; // for testing purposes
+
+    // directory holds the runs; memoryPosts is the size of the front
+    ExternalSQueue(prifn_t priFn, HEAPTYPE heapType, const string& directory, int memoryPosts = 1 << 20);
+    ~ExternalSQueue();
+    ExternalSQueue(const ExternalSQueue& rhs) = delete; // runs are owned by one queue
+    ExternalSQueue& operator=(const ExternalSQueue& rhs) = delete;
+    bool insertPost(const Post& post); // false if the priority is invalid
+    Post getNextPost(); // Returns the highest priority post
+    long long numPosts() const; // may exceed the range of an int
+    HEAPTYPE getHeapType() const;
+    int numRuns() const;
+    long long getBytesWritten() const; // disk traffic since the queue was created
+    long long getBytesRead() const;
+    void clear();
+
+    private:
+    // A sorted run on disk, read one block at a time
+    struct Run{
+        int m_fd;
+        int m_level;                // 0 for a spilled front, l + 1 when merged from runs of level l
+        long long m_length;         // posts in the file
+        long long m_read;           // posts read into blocks so far
+        vector<uint64_t> m_block;   // payloads of the current block
+        size_t m_position;          // next post of the block
+        int m_key;                  // key of that post
+    };
+
+    prifn_t m_priorFunc;    // Function to compute priority
+    HEAPTYPE m_heapType;    // either a MINHEAP or a MAXHEAP
+    string m_directory;
+    int m_memoryPosts;      // posts of the front that trigger a spill
+    SQueue m_front;
+    vector<Run*> m_runs;    // heap of the runs, the lowest head key first
+    long long m_size;       // posts in the front and the runs
+    long long m_bytesWritten;
+    long long m_bytesRead;
+
+    // priority, negated for a MAXHEAP, so that a lower key is better
+    int key(uint64_t payload) const;
+    void spill();
+    void compact();
+    Run* openRun(int level);
+    void writeBlock(Run* run, vector<uint64_t>& block);
+    bool fill(Run* run);
+    bool advance(Run* run);
+    static void closeRun(Run* run);
+    static bool later(const Run* run1, const Run* run2);
+};
+#endif
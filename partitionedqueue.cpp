@@ -0,0 +1,215 @@
+
+#include "partitionedqueue.h"
+#include <algorithm>
+
+// PartitionedQueue constructor: routes posts with a partition function
+PartitionedQueue::PartitionedQueue(prifn_t priFn, HEAPTYPE heapType, STRUCTURE structure, int numPartitions, partfn_t partFn) {
+    if (numPartitions < 1)
+        throw out_of_range("Invalid number of partitions");
+    m_priorFunc = priFn;
+    m_heapType = heapType;
+    m_partFn = partFn;
+    createPartitions(structure, numPartitions);
+}
+
+// PartitionedQueue constructor: routes posts by the band of their priority
+PartitionedQueue::PartitionedQueue(prifn_t priFn, HEAPTYPE heapType, STRUCTURE structure, const vector<int>& bandLimits) {
+    for (size_t i = 1; i < bandLimits.size(); i++)
+        if (bandLimits[i] <= bandLimits[i - 1])
+            throw domain_error("Band limits must be increasing");
+    m_priorFunc = priFn;
+    m_heapType = heapType;
+    m_partFn = nullptr;
+    m_bandLimits = bandLimits;
+    createPartitions(structure, (int)bandLimits.size() + 1);
+}
+
+// PartitionedQueue destructor: deletes every partition with its posts
+PartitionedQueue::~PartitionedQueue() {
+    for (size_t i = 0; i < m_partitions.size(); i++)
+        delete m_partitions[i];
+}
+
+// Partition destructor: frees the posts left in the inbox
+PartitionedQueue::Partition::~Partition() {
+    InboxNode* node = m_inbox.load(memory_order_acquire);
+    while (node != nullptr){
+        InboxNode* next = node->m_next;
+        delete node;
+        node = next;
+    }
+}
+
+// Inserts a post into the partition it is routed to: pushes it onto the inbox,
+// then counts it, so that a consumer that sees the count also sees the post
+bool PartitionedQueue::insertPost(const Post& post) {
+    if (m_priorFunc(post) == 0)
+        return false;
+    Partition* partition = m_partitions[partitionOf(post)];
+    InboxNode* node = new InboxNode;
+    node->m_payload = post.getPayload();
+    node->m_next = partition->m_inbox.load(memory_order_relaxed);
+    while (!partition->m_inbox.compare_exchange_weak(node->m_next, node, memory_order_release, memory_order_relaxed))
+        ;
+    partition->m_size.fetch_add(1, memory_order_release);
+    return true;
+}
+
+// Retrieves and removes the highest priority post of a partition that has no
+// other consumer thread, without locking. The first call claims the partition
+// for the calling thread under its lock, so no locked pop is still running on it
+Post PartitionedQueue::consumeNextPost(int partition) {
+    if (partition < 0 || partition >= (int)m_partitions.size())
+        throw out_of_range("Invalid partition");
+    Partition* owned = m_partitions[partition];
+    thread::id self = this_thread::get_id();
+    if (owned->m_owner.load(memory_order_acquire) != self){
+        lock_guard<mutex> guard(owned->m_lock);
+        thread::id none;
+        if (!owned->m_owner.compare_exchange_strong(none, self, memory_order_acq_rel))
+            throw domain_error("Partition is owned by another consumer");
+    }
+    drain(owned);
+    return pop(owned);
+}
+
+// Hands a partition back from its owner, so that the locked pops may use it
+// again; a partition that nobody owns is left as it is
+void PartitionedQueue::releasePartition(int partition) {
+    if (partition < 0 || partition >= (int)m_partitions.size())
+        throw out_of_range("Invalid partition");
+    thread::id owner = m_partitions[partition]->m_owner.load(memory_order_relaxed);
+    if (owner == thread::id())
+        return;
+    if (owner != this_thread::get_id())
+        throw domain_error("Partition is owned by another consumer");
+    m_partitions[partition]->m_owner.store(thread::id(), memory_order_release);
+}
+
+// Retrieves and removes the highest priority post of one partition
+Post PartitionedQueue::getNextPost(int partition) {
+    if (partition < 0 || partition >= (int)m_partitions.size())
+        throw out_of_range("Invalid partition");
+    lock_guard<mutex> guard(m_partitions[partition]->m_lock);
+    if (m_partitions[partition]->m_owner.load(memory_order_acquire) != thread::id())
+        throw domain_error("Partition is owned by a consumer");
+    drain(m_partitions[partition]);
+    return pop(m_partitions[partition]);
+}
+
+// Retrieves and removes the highest priority post across all partitions. The
+// partitions are locked in index order, their roots compared, and the best one
+// popped. An owned partition cannot be claimed while all of them are locked
+Post PartitionedQueue::getNextPost() {
+    for (size_t i = 0; i < m_partitions.size(); i++)
+        m_partitions[i]->m_lock.lock();
+    for (size_t i = 0; i < m_partitions.size(); i++){
+        if (m_partitions[i]->m_owner.load(memory_order_acquire) != thread::id()){
+            for (size_t j = 0; j < m_partitions.size(); j++)
+                m_partitions[j]->m_lock.unlock();
+            throw domain_error("Partition is owned by a consumer");
+        }
+    }
+
+    int best = -1;
+    int bestPriority = 0;
+    for (size_t i = 0; i < m_partitions.size(); i++){
+        drain(m_partitions[i]);
+        SQueue& queue = m_partitions[i]->m_queue;
+        if (queue.numPosts() == 0)
+            continue;
+        int priority = m_priorFunc(queue.peekNextPost());
+        if (best < 0 || (m_heapType == MINHEAP ? priority < bestPriority : priority > bestPriority)){
+            best = (int)i;
+            bestPriority = priority;
+        }
+    }
+
+    Post post;
+    bool found = (best >= 0);
+    if (found)
+        post = pop(m_partitions[best]);
+    for (size_t i = 0; i < m_partitions.size(); i++)
+        m_partitions[i]->m_lock.unlock();
+    if (!found)
+        throw out_of_range("Empty Queue");
+    return post;
+}
+
+// Returns the number of posts in one partition. A post being popped while its
+// producer has not counted it yet can make the count briefly negative
+int PartitionedQueue::numPosts(int partition) const {
+    if (partition < 0 || partition >= (int)m_partitions.size())
+        throw out_of_range("Invalid partition");
+    return max(m_partitions[partition]->m_size.load(memory_order_acquire), 0);
+}
+
+// Returns the number of posts in all partitions
+int PartitionedQueue::numPosts() const {
+    int total = 0;
+    for (size_t i = 0; i < m_partitions.size(); i++)
+        total += numPosts((int)i);
+    return total;
+}
+
+// Returns the number of partitions
+int PartitionedQueue::numPartitions() const {
+    return (int)m_partitions.size();
+}
+
+// Returns the partition a post is routed to
+int PartitionedQueue::partitionOf(const Post& post) const {
+    if (m_partFn != nullptr){
+        int partition = m_partFn(post);
+        if (partition < 0 || partition >= (int)m_partitions.size())
+            throw out_of_range("Invalid partition");
+        return partition;
+    }
+    int priority = m_priorFunc(post);
+    int band = 0;
+    while (band < (int)m_bandLimits.size() && priority > m_bandLimits[band])
+        band++;
+    return band;
+}
+
+// Creates the partitions, all with the same priority function, heap type and
+// structure. If one cannot be allocated, the ones created so far are deleted
+// before the exception reaches the caller
+void PartitionedQueue::createPartitions(STRUCTURE structure, int numPartitions) {
+    if (structure == RADIX)
+        throw domain_error("Radix partitions are not supported");
+    m_partitions.reserve(numPartitions); // push_back cannot throw after a successful new
+    try{
+        for (int i = 0; i < numPartitions; i++)
+            m_partitions.push_back(new Partition(m_priorFunc, m_heapType, structure));
+    }
+    catch (...){
+        for (size_t i = 0; i < m_partitions.size(); i++)
+            delete m_partitions[i];
+        m_partitions.clear();
+        throw;
+    }
+}
+
+// Moves the posts of the inbox into the SQueue, oldest first
+void PartitionedQueue::drain(Partition* partition) {
+    InboxNode* node = partition->m_inbox.exchange(nullptr, memory_order_acquire);
+    if (node == nullptr)
+        return;
+    vector<Post> posts;
+    while (node != nullptr){
+        posts.push_back(Post(node->m_payload));
+        InboxNode* next = node->m_next;
+        delete node;
+        node = next;
+    }
+    reverse(posts.begin(), posts.end());
+    partition->m_queue.insertPosts(posts.data(), (int)posts.size());
+}
+
+// Removes the root of a drained partition and uncounts it
+Post PartitionedQueue::pop(Partition* partition) {
+    Post post = partition->m_queue.getNextPost(); // throws on an empty partition
+    partition->m_size.fetch_sub(1, memory_order_release);
+    return post;
+}
@@ -0,0 +1,77 @@
+#ifndef PARTITIONEDQUEUE_H
+#define PARTITIONEDQUEUE_H
+#include "squeue.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+class Tester;   // forward declaration (for testing purposes)
+
+// Partition function pointer type: returns the partition index of a post
+typedef int (*partfn_t)(const Post&);
+
+// A post queue split into independent SQueues. Every insertPost is routed to one
+// partition, either by a partition function over the Post fields or by the band
+// its priority falls into. Producers never lock: they push the post onto the
+// partition's inbox, a lock-free stack that the consumer moves into the SQueue
+// before it pops. A partition with a single consumer thread is popped with
+// consumeNextPost(): the first call makes the calling thread the owner of the
+// partition (taking its lock once), and from then on it pops without locking.
+// Partitions shared by several consumers are popped with getNextPost(partition),
+// under the partition's lock; getNextPost() without a partition locks them all
+// and takes the best root. Both throw domain_error while a partition they need
+// is owned, until its owner calls releasePartition(), and consumeNextPost()
+// throws on a partition owned by another thread. Radix partitions are not supported: the monotone check would only run when
+// the inbox is moved, long after the producer returned
+class PartitionedQueue{
+    public:
+    friend class Tester; // for testing purposes
+
+    PartitionedQueue(prifn_t priFn, HEAPTYPE heapType, STRUCTURE structure, int numPartitions, partfn_t partFn);
+    // Priority bands: partition i holds the priorities up to bandLimits[i], the last
+    // partition holds everything above bandLimits.back()
+    PartitionedQueue(prifn_t priFn, HEAPTYPE heapType, STRUCTURE structure, const vector<int>& bandLimits);
+    ~PartitionedQueue();
+    PartitionedQueue(const PartitionedQueue& rhs) = delete; // partitions own their locks
+    PartitionedQueue& operator=(const PartitionedQueue& rhs) = delete;
+    bool insertPost(const Post& post); // false if the priority is invalid
+    Post consumeNextPost(int partition); // Like getNextPost(partition), for its only consumer thread
+    void releasePartition(int partition); // Ends the ownership of the calling thread
+    Post getNextPost(int partition); // Highest priority post of one partition
+    Post getNextPost(); // Highest priority post across all partitions
+    int numPosts(int partition) const; // includes posts still in the inbox
+    int numPosts() const;
+    int numPartitions() const;
+    int partitionOf(const Post& post) const; // Partition a post is routed to
+
+    private:
+    // A post pushed by a producer and not yet moved into the SQueue
+    struct InboxNode{
+        uint64_t m_payload;
+        InboxNode* m_next;
+    };
+
+    // A partition on its own cache lines, so that inboxes and locks of neighbours do not share one
+    struct alignas(64) Partition{
+        Partition(prifn_t priFn, HEAPTYPE heapType, STRUCTURE structure)
+            : m_queue(priFn, heapType, structure), m_inbox(nullptr), m_size(0) {}
+        ~Partition();
+        SQueue m_queue;                 // touched only by the consumer
+        atomic<InboxNode*> m_inbox;     // newest post first
+        atomic<int> m_size;             // posts in the SQueue and the inbox
+        atomic<thread::id> m_owner;     // consumer thread of consumeNextPost, none if default
+        mutex m_lock;                   // serializes the consumers of getNextPost
+    };
+
+    prifn_t m_priorFunc;            // priority function of every partition
+    HEAPTYPE m_heapType;            // heap type of every partition
+    partfn_t m_partFn;              // partition function, nullptr when routing by band
+    vector<int> m_bandLimits;       // upper priority of every band but the last
+    vector<Partition*> m_partitions;
+
+    void createPartitions(STRUCTURE structure, int numPartitions);
+    static void drain(Partition* partition); // Moves the inbox into the SQueue
+    static Post pop(Partition* partition);
+};
+#endif
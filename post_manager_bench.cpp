@@ -0,0 +1,950 @@
+#include "squeue.h"
+#include "queuemanager.h"
+#include "partitionedqueue.h"
+#include "asyncqueue.h"
+#include "boundedsqueue.h"
+#include "sharedsqueue.h"
+#include "softsqueue.h"
+#include "workload.h"
+#include "externalsqueue.h"
+#include <cstring>
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <ctime>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <unordered_map>
+#include <algorithm>
+#include <vector>
+using namespace std;
+
+// Declaration of priority functions for sorting Posts in the SQueue
+int priorityFn1(const Post &post); // Designed to work with a MAXHEAP
+int priorityFn2(const Post &post); // Designed to work with a MINHEAP
+
+// Generates posts with every field drawn uniformly from its valid range
+class PostGen {
+public:
+    PostGen() : m_generator(10) {} // 10 is the fixed seed value for reproducibility
+    Post getPost(){
+        return Post(uniform(MINPOSTID, MAXPOSTID),
+                    uniform(MINLIKES, MAXLIKES),
+                    uniform(MINCONLEVEL, MAXCONLEVEL),
+                    uniform(MINTIME, MAXTIME),
+                    uniform(MININTERESTLEVEL, MAXINTERESTLEVEL));
+    }
+private:
+    int uniform(int min, int max){
+        return std::uniform_int_distribution<>(min, max)(m_generator);
+    }
+    std::mt19937 m_generator;
+};
+
+// Returns the milliseconds elapsed since start
+double elapsedMs(std::chrono::steady_clock::time_point start){
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Merges many small queues into one queue and then pops only a handful of posts
+double benchMergeHeavy(STRUCTURE structure, bool lazy, int numQueues, int queueSize, int numPops){
+    PostGen gen;
+    vector<SQueue*> small;
+    for (int i = 0; i < numQueues; i++){
+        small.push_back(new SQueue(priorityFn1, MAXHEAP, structure));
+        for (int j = 0; j < queueSize; j++)
+            small[i]->insertPost(gen.getPost());
+    }
+    SQueue big(priorityFn1, MAXHEAP, structure);
+    big.setLazyMerge(lazy);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < numQueues; i++)
+        big.mergeWithQueue(*small[i]);
+    for (int i = 0; i < numPops; i++)
+        big.getNextPost();
+    double ms = elapsedMs(start);
+
+    for (int i = 0; i < numQueues; i++)
+        delete small[i];
+    return ms;
+}
+
+// Insert-heavy workload with frequent melds: every round inserts into a small
+// queue, melds it into the main queue and pops one post
+double benchInsertMeld(STRUCTURE structure, int rounds, int insertsPerRound){
+    PostGen gen;
+    SQueue main(priorityFn1, MAXHEAP, structure);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++){
+        SQueue batch(priorityFn1, MAXHEAP, structure);
+        for (int j = 0; j < insertsPerRound; j++)
+            batch.insertPost(gen.getPost());
+        main.mergeWithQueue(batch);
+        main.getNextPost();
+    }
+    while (main.numPosts() > 0)
+        main.getNextPost();
+    return elapsedMs(start);
+}
+
+// Monotone MINHEAP consumption keyed by post time: every pop is followed by an
+// insert of a post that is not ahead of the popped one
+double benchMonotone(STRUCTURE structure, int size, int rounds){
+    PostGen gen;
+    SQueue queue(priorityFn2, MINHEAP, structure);
+    for (int i = 0; i < size; i++)
+        queue.insertPost(gen.getPost());
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++){
+        int last = priorityFn2(queue.getNextPost());
+        Post post = gen.getPost();
+        while (priorityFn2(post) < last)
+            post = gen.getPost();
+        queue.insertPost(post);
+    }
+    return elapsedMs(start);
+}
+
+// A queue whose operation mix drifts: it is filled by melding in small queues,
+// then serves one pop per insert, then drains. For AUTO, prints the structure
+// changes it made
+double benchDrift(STRUCTURE structure, int fill, int rounds){
+    PostGen gen;
+    SQueue queue(priorityFn1, MAXHEAP, structure);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < fill / 8; i++){
+        SQueue batch(priorityFn1, MAXHEAP, structure);
+        for (int j = 0; j < 8; j++)
+            batch.insertPost(gen.getPost());
+        queue.mergeWithQueue(batch);
+    }
+    for (int i = 0; i < rounds; i++){
+        queue.getNextPost();
+        queue.insertPost(gen.getPost());
+    }
+    while (queue.numPosts() > 0)
+        queue.getNextPost();
+    double ms = elapsedMs(start);
+    if (structure == AUTO)
+        queue.printStructureChanges();
+    return ms;
+}
+
+// Simulated clock for the static-priority baseline of the decay benchmark
+int g_now = 0;
+// Age-scaled priorities: the baseline has to rebuild the heap on every tick to
+// follow them. setPriorityFn only rebuilds when the heap type changes, so the
+// ticks alternate between a MAXHEAP function and its MINHEAP mirror
+int agedMaxFn(const Post &post){ return (post.getNumLikes() + post.getInterestLevel()) * 1000 / (g_now + 1) + 1; }
+int agedMinFn(const Post &post){ return 1000000 - agedMaxFn(post); }
+
+// A day of ticking time (one tick per minute) at a steady queue size: every
+// tick inserts and pops a batch of posts. Returns the time of the decay-aware
+// queue, or of the rebuild-every-tick baseline
+double benchDecayDay(bool decay, int size, int ticks, int batch){
+    PostGen gen;
+    g_now = 0;
+    SQueue queue(decay ? priorityFn1 : agedMaxFn, MAXHEAP, LEFTIST);
+    if (decay)
+        queue.setDecay(60); // priorities halve every hour
+    for (int i = 0; i < size; i++)
+        queue.insertPost(gen.getPost());
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int t = 0; t < ticks; t++){
+        if (decay)
+            queue.advanceEpoch();
+        else{
+            g_now++;
+            if (queue.getHeapType() == MAXHEAP)
+                queue.setPriorityFn(agedMinFn, MINHEAP);
+            else
+                queue.setPriorityFn(agedMaxFn, MAXHEAP);
+        }
+        for (int i = 0; i < batch; i++)
+            queue.insertPost(gen.getPost());
+        for (int i = 0; i < batch; i++)
+            queue.getNextPost();
+    }
+    return elapsedMs(start);
+}
+
+// Bulk insertion and re-prioritization of a large queue: one insertPost call per
+// post with a priority function, insertPosts with the function, and insertPosts
+// with the equivalent linear model. mode is 0, 1 or 2 respectively
+void benchLinearPriority(int mode, int size){
+    PostGen gen;
+    vector<Post> posts;
+    for (int i = 0; i < size; i++)
+        posts.push_back(gen.getPost());
+    LinearPriority model1(1, 0, 0, 1, 0, 1, 510);   // same as priorityFn1
+    LinearPriority model2(0, 1, 1, 0, 0, 2, 55);    // same as priorityFn2
+
+    SQueue queue = mode == 2 ? SQueue(model1, MAXHEAP, LEFTIST) : SQueue(priorityFn1, MAXHEAP, LEFTIST);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (mode == 0)
+        for (int i = 0; i < size; i++)
+            queue.insertPost(posts[i]);
+    else
+        queue.insertPosts(posts.data(), size);
+    double insertMs = elapsedMs(start);
+
+    start = std::chrono::steady_clock::now();
+    if (mode == 2)
+        queue.setPriorityModel(model2, MINHEAP);
+    else
+        queue.setPriorityFn(priorityFn2, MINHEAP);
+    double rebuildMs = elapsedMs(start);
+    cout << "insert: " << insertMs << " ms  re-prioritize: " << rebuildMs << " ms\n";
+}
+
+// Whole-tree operations on a large queue with a given number of threads:
+// deep copy, priority swap (rekey and rebuild), SKEW to LEFTIST and teardown
+void benchThreads(int threads, int size){
+    PostGen gen;
+    SQueue queue(priorityFn1, MAXHEAP, SKEW);
+    for (int i = 0; i < size; i++)
+        queue.insertPost(gen.getPost());
+    queue.setThreads(threads);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    SQueue* copy = new SQueue(queue);
+    double copyMs = elapsedMs(start);
+    start = std::chrono::steady_clock::now();
+    copy->setPriorityFn(priorityFn2, MINHEAP);
+    double rebuildMs = elapsedMs(start);
+    start = std::chrono::steady_clock::now();
+    copy->setStructure(LEFTIST);
+    double leftistMs = elapsedMs(start);
+    start = std::chrono::steady_clock::now();
+    delete copy;
+    double clearMs = elapsedMs(start);
+    cout << "  " << threads << " threads  copy: " << copyMs << " ms  rebuild: " << rebuildMs
+         << " ms  to leftist: " << leftistMs << " ms  clear: " << clearMs << " ms\n";
+}
+
+// Feed preview: the top k posts of a large queue, read with the ordered
+// iterator or by popping from a copy of the queue
+void benchTopK(int size, int k){
+    PostGen gen;
+    SQueue queue(priorityFn1, MAXHEAP, LEFTIST);
+    for (int i = 0; i < size; i++)
+        queue.insertPost(gen.getPost());
+
+    long long checksum = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    SQueue::const_iterator it = queue.begin();
+    for (int i = 0; i < k && it != queue.end(); i++, ++it)
+        checksum += it->getPostID();
+    double iterMs = elapsedMs(start);
+
+    start = std::chrono::steady_clock::now();
+    SQueue copy(queue);
+    for (int i = 0; i < k; i++)
+        checksum -= copy.getNextPost().getPostID();
+    double copyMs = elapsedMs(start);
+    cout << "  top " << k << "  iterator: " << iterMs << " ms  copy and pop: " << copyMs << " ms\n";
+}
+
+// Draws user IDs 0..users-1 with a Zipf distribution of exponent s
+class ZipfGen {
+public:
+    ZipfGen(int users, double s) : m_generator(10) {
+        double sum = 0;
+        for (int i = 1; i <= users; i++){
+            sum += 1.0 / pow((double)i, s);
+            m_cdf.push_back(sum);
+        }
+        for (size_t i = 0; i < m_cdf.size(); i++)
+            m_cdf[i] /= sum;
+    }
+    int getUser(){
+        double u = std::uniform_real_distribution<double>(0.0, 1.0)(m_generator);
+        return (int)(std::lower_bound(m_cdf.begin(), m_cdf.end(), u) - m_cdf.begin());
+    }
+private:
+    std::mt19937 m_generator;
+    vector<double> m_cdf;
+};
+
+// Multi-tenant workload: posts are inserted for Zipf-distributed users, then
+// popped for Zipf-distributed users. Compares the QueueManager with one
+// SQueue per user in a hash map
+void benchTenants(int users, int inserts){
+    vector<int> owners;
+    vector<Post> posts;
+    ZipfGen zipf(users, 1.1);
+    PostGen gen;
+    for (int i = 0; i < inserts; i++){
+        owners.push_back(zipf.getUser());
+        posts.push_back(gen.getPost());
+    }
+
+    QueueManager manager(priorityFn1, MAXHEAP, LEFTIST, 16);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < inserts; i++)
+        manager.insertPost(owners[i], posts[i]);
+    double insertMs = elapsedMs(start);
+    double bytes = (double)manager.memoryUsage() / manager.numQueues();
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < inserts; i++)
+        if (manager.numPosts(owners[i]) > 0)
+            manager.getNextPost(owners[i]);
+    double popMs = elapsedMs(start);
+    cout << "  QueueManager:    " << manager.numQueues() << " queues, " << bytes << " bytes/queue, insert "
+         << inserts / insertMs / 1000 << " M/s, pop " << inserts / popMs / 1000 << " M/s\n";
+
+    unordered_map<int, SQueue*> queues;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < inserts; i++){
+        SQueue*& queue = queues[owners[i]];
+        if (queue == nullptr)
+            queue = new SQueue(priorityFn1, MAXHEAP, LEFTIST);
+        queue->insertPost(posts[i]);
+    }
+    insertMs = elapsedMs(start);
+    // Map entry and bucket, queue object and one node per post
+    bytes = (double)queues.size() * (sizeof(pair<const int, SQueue*>) + 3 * sizeof(void*) + sizeof(SQueue))
+          + (double)inserts * sizeof(Post);
+    bytes /= queues.size();
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < inserts; i++)
+        if (queues[owners[i]]->numPosts() > 0)
+            queues[owners[i]]->getNextPost();
+    popMs = elapsedMs(start);
+    cout << "  SQueue per user: " << queues.size() << " queues, " << bytes << " bytes/queue, insert "
+         << inserts / insertMs / 1000 << " M/s, pop " << inserts / popMs / 1000 << " M/s\n";
+    for (unordered_map<int, SQueue*>::iterator it = queues.begin(); it != queues.end(); it++)
+        delete it->second;
+}
+
+// Routes posts by connection level: levels 1-2, 3 and 4-5
+int connectionPartition(const Post &post){
+    int level = post.getConnectLevel();
+    return level <= 2 ? 0 : (level == 3 ? 1 : 2);
+}
+
+// Parallel consumers that only want their own slice of the feed: with one
+// shared SQueue behind a lock they pop everything and discard other slices;
+// with a partitioned queue each consumer pops its own partition
+void benchPartitions(int size){
+    PostGen gen;
+    vector<Post> posts;
+    for (int i = 0; i < size; i++)
+        posts.push_back(gen.getPost());
+    const int consumers = 3;
+
+    SQueue shared(priorityFn1, MAXHEAP, LEFTIST);
+    shared.insertPosts(posts.data(), size);
+    mutex sharedLock;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    vector<thread> threads;
+    for (int c = 0; c < consumers; c++){
+        threads.push_back(thread([&shared, &sharedLock, c]{
+            long long wanted = 0;
+            while (true){
+                lock_guard<mutex> guard(sharedLock);
+                if (shared.numPosts() == 0) break;
+                if (connectionPartition(shared.getNextPost()) == c) wanted++;
+            }
+        }));
+    }
+    for (int c = 0; c < consumers; c++)
+        threads[c].join();
+    double sharedMs = elapsedMs(start);
+
+    PartitionedQueue partitioned(priorityFn1, MAXHEAP, LEFTIST, consumers, connectionPartition);
+    for (int i = 0; i < size; i++)
+        partitioned.insertPost(posts[i]);
+    threads.clear();
+    start = std::chrono::steady_clock::now();
+    for (int c = 0; c < consumers; c++){
+        threads.push_back(thread([&partitioned, c]{
+            while (partitioned.numPosts(c) > 0)
+                partitioned.consumeNextPost(c);
+            partitioned.releasePartition(c);
+        }));
+    }
+    for (int c = 0; c < consumers; c++)
+        threads[c].join();
+    double partitionedMs = elapsedMs(start);
+    cout << "  shared locked SQueue: " << sharedMs << " ms  partitioned: " << partitionedMs << " ms\n";
+}
+
+// Wake-up latency of a consumer: send times are indexed by post ID - MINPOSTID
+struct WakeupStats{
+    vector<std::chrono::steady_clock::time_point> m_sent;
+    double m_totalUs = 0;
+    double m_maxUs = 0;
+    void received(const Post& post){
+        double us = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - m_sent[post.getPostID() - MINPOSTID]).count();
+        m_totalUs += us;
+        if (us > m_maxUs) m_maxUs = us;
+    }
+};
+
+AsyncTask awaitPosts(AsyncQueue& queue, WakeupStats& stats){
+    while (optional<Post> post = co_await queue.next())
+        stats.received(*post);
+}
+
+// A producer sends one post every gapUs microseconds to a consumer that either
+// polls a locked SQueue (catching out_of_range when it is empty) or co_awaits an
+// AsyncQueue on an executor thread. Prints the mean and max delay from insert to
+// the consumer seeing the post, and the CPU time of the whole process
+void benchWakeup(bool async, int count, int gapUs){
+    WakeupStats stats;
+    stats.m_sent.resize(count);
+    std::clock_t cpuStart = std::clock();
+    if (async){
+        Executor executor;
+        AsyncQueue queue(priorityFn1, MAXHEAP, LEFTIST, executor);
+        awaitPosts(queue, stats);
+        thread consumer([&executor]{ executor.run(); });
+        for (int i = 0; i < count; i++){
+            std::this_thread::sleep_for(std::chrono::microseconds(gapUs));
+            stats.m_sent[i] = std::chrono::steady_clock::now();
+            queue.insertPost(Post(MINPOSTID + i, 100, MINCONLEVEL, MINTIME, MININTERESTLEVEL));
+        }
+        queue.close();
+        executor.stop();
+        consumer.join();
+    }
+    else{
+        SQueue queue(priorityFn1, MAXHEAP, LEFTIST);
+        mutex lock;
+        thread consumer([&queue, &lock, &stats, count]{
+            int received = 0;
+            while (received < count){
+                lock_guard<mutex> guard(lock);
+                try{
+                    stats.received(queue.getNextPost());
+                    received++;
+                }
+                catch (out_of_range&){}
+            }
+        });
+        for (int i = 0; i < count; i++){
+            std::this_thread::sleep_for(std::chrono::microseconds(gapUs));
+            lock_guard<mutex> guard(lock);
+            stats.m_sent[i] = std::chrono::steady_clock::now();
+            queue.insertPost(Post(MINPOSTID + i, 100, MINCONLEVEL, MINTIME, MININTERESTLEVEL));
+        }
+        consumer.join();
+    }
+    double cpuMs = 1000.0 * (std::clock() - cpuStart) / CLOCKS_PER_SEC;
+    cout << "  mean wake-up: " << stats.m_totalUs / count << " us  max: " << stats.m_maxUs
+         << " us  process CPU: " << cpuMs << " ms\n";
+}
+
+// Writes a queue of size posts to /dev/null: once formatted per post through an
+// ostream with endl, as printPostsQueue used to, and once per export format
+// through a PostSink streaming to the file descriptor
+void benchExport(int size){
+    PostGen gen;
+    SQueue queue(priorityFn1, MAXHEAP, LEFTIST);
+    vector<Post> posts;
+    for (int i = 0; i < size; i++){
+        posts.push_back(gen.getPost());
+        queue.insertPost(posts.back());
+    }
+    ofstream devNull("/dev/null");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < size; i++)
+        devNull << "[" << priorityFn1(posts[i]) << "] Post#: " << posts[i].getPostID() << ", likes#: "
+                << posts[i].getNumLikes() << ", connect level: " << posts[i].getConnectLevel() << endl;
+    cout << "  ostream with endl per post: " << elapsedMs(start) << " ms\n";
+
+    const char* names[] = {"TEXT", "JSON", "BINARY"};
+    EXPORTFORMAT formats[] = {TEXT, JSON, BINARY};
+    int fd = open("/dev/null", O_WRONLY);
+    for (int f = 0; f < 3; f++){
+        start = std::chrono::steady_clock::now();
+        size_t bytes;
+        {
+            PostSink sink(fd);
+            queue.exportPosts(sink, formats[f]);
+            sink.flush();
+            bytes = sink.size();
+        }
+        double ms = elapsedMs(start);
+        cout << "  exportPosts " << names[f] << ": " << ms << " ms (" << bytes / ms / 1000 << " MB/s)\n";
+    }
+    close(fd);
+}
+
+// Time for clear() to return on a queue of size posts, freeing the nodes on the
+// calling thread or handing them to the background reclaimer
+void benchTeardown(bool deferred, int size){
+    PostGen gen;
+    SQueue queue(priorityFn1, MAXHEAP, LEFTIST);
+    queue.setDeferredClear(deferred);
+    for (int i = 0; i < size; i++)
+        queue.insertPost(gen.getPost());
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    queue.clear();
+    double clearMs = elapsedMs(start);
+    SQueue::waitForReclaim();
+    cout << "  clear() returns after " << clearMs << " ms, nodes freed after " << elapsedMs(start) << " ms\n";
+}
+
+// Node footprint and the throughput of draining a queue of size posts
+void benchFootprint(STRUCTURE structure, int size){
+    PostGen gen;
+    SQueue queue(priorityFn1, MAXHEAP, structure);
+    for (int i = 0; i < size; i++)
+        queue.insertPost(gen.getPost());
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    long long checksum = 0;
+    while (queue.numPosts() > 0)
+        checksum += queue.getNextPost().getPostID();
+    double ms = elapsedMs(start);
+    cout << "nodes: " << (double)size * sizeof(Post) / (1 << 20) << " MB  pops: "
+         << size / ms / 1000 << " M/s  (checksum " << checksum << ")\n";
+}
+
+// A feed capped at capacity posts receiving a stream of count posts: an SQueue
+// that is drained and rebuilt without its worst post whenever it overflows,
+// against a BoundedSQueue that evicts in place
+void benchBounded(bool bounded, int capacity, int count){
+    PostGen gen;
+    vector<Post> posts;
+    for (int i = 0; i < count; i++)
+        posts.push_back(gen.getPost());
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    long long checksum = 0;
+    if (bounded){
+        BoundedSQueue feed(priorityFn1, MAXHEAP, capacity);
+        for (int i = 0; i < count; i++)
+            feed.insertPost(posts[i]);
+        checksum = priorityFn1(feed.peekNextPost()) + priorityFn1(feed.peekWorstPost());
+    }
+    else{
+        SQueue feed(priorityFn1, MAXHEAP, LEFTIST);
+        vector<Post> drained;
+        for (int i = 0; i < count; i++){
+            feed.insertPost(posts[i]);
+            if (feed.numPosts() > capacity){
+                drained.clear();
+                while (feed.numPosts() > 0)
+                    drained.push_back(feed.getNextPost());
+                feed.insertPosts(drained.data(), capacity); // all but the worst
+            }
+        }
+        checksum = priorityFn1(feed.peekNextPost()) + priorityFn1(drained[capacity - 1]);
+    }
+    cout << elapsedMs(start) << " ms (best + worst priority " << checksum << ")\n";
+}
+
+// Fills a queue with size posts and runs rounds of one pop and one insert, with an
+// exact SQueue (errorRate 0) or a SoftSQueue. Prints the throughput and the rank
+// error of the pops: how many queued posts had a strictly higher priority than the
+// post returned, computed afterwards by replaying the pops against a histogram
+void benchApproximate(STRUCTURE structure, double errorRate, int size, int rounds){
+    PostGen gen;
+    vector<Post> posts;
+    for (int i = 0; i < size + rounds; i++)
+        posts.push_back(gen.getPost());
+    vector<int> popped(rounds);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (errorRate > 0){
+        SoftSQueue queue(priorityFn1, MAXHEAP, errorRate);
+        for (int i = 0; i < size; i++)
+            queue.insertPost(posts[i]);
+        for (int i = 0; i < rounds; i++){
+            popped[i] = priorityFn1(queue.getNextPost());
+            queue.insertPost(posts[size + i]);
+        }
+    }
+    else{
+        SQueue queue(priorityFn1, MAXHEAP, structure);
+        for (int i = 0; i < size; i++)
+            queue.insertPost(posts[i]);
+        for (int i = 0; i < rounds; i++){
+            popped[i] = priorityFn1(queue.getNextPost());
+            queue.insertPost(posts[size + i]);
+        }
+    }
+    double ms = elapsedMs(start);
+
+    vector<int> queued(511, 0); // priorityFn1 ranges over 1..510
+    for (int i = 0; i < size; i++)
+        queued[priorityFn1(posts[i])]++;
+    vector<int> errors(rounds);
+    int exact = 0;
+    for (int i = 0; i < rounds; i++){
+        int better = 0;
+        for (int priority = popped[i] + 1; priority <= 510; priority++)
+            better += queued[priority];
+        errors[i] = better;
+        if (better == 0)
+            exact++;
+        queued[popped[i]]--;
+        queued[priorityFn1(posts[size + i])]++;
+    }
+    sort(errors.begin(), errors.end());
+    cout << (size + 2.0 * rounds) / ms / 1000 << " M ops/s, rank error p50 " << errors[rounds / 2]
+         << " p99 " << errors[rounds * 99 / 100] << " max " << errors[rounds - 1]
+         << " (" << 100.0 * errors[rounds - 1] / size << "% of the queue), exact pops "
+         << 100.0 * exact / rounds << "%\n";
+}
+
+// A producer process hands count posts to this process in batches of 64. Over
+// a socket the posts are serialized and the consumer inserts them into its own
+// SQueue; with a SharedSQueue the producer inserts them into shared memory and
+// the consumer pops them from there. Prints posts per second end to end
+void benchTwoProcess(bool shared, int count){
+    PostGen gen;
+    vector<Post> posts;
+    for (int i = 0; i < count; i++)
+        posts.push_back(gen.getPost());
+    const int batch = 64;
+    string name = "/squeue_bench_" + to_string(getpid());
+    SharedSQueue* queue = nullptr;
+    int sockets[2];
+    if (shared){
+        SharedSQueue::unlink(name);
+        queue = new SharedSQueue(name, priorityFn1, MAXHEAP, 4 * batch); // a queue depth like the socket side's
+    }
+    else if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0)
+        return;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    pid_t child = fork();
+    if (child == 0){
+        if (shared){
+            SharedSQueue producer(name, priorityFn1);
+            for (int i = 0; i < count; ){
+                int inserted = producer.insertPosts(&posts[i], min(batch, count - i));
+                if (inserted == 0) sched_yield(); // full: let the consumer catch up
+                i += inserted;
+            }
+        }
+        else{
+            close(sockets[0]);
+            int fields[batch * 5];
+            for (int i = 0; i < count; i += batch){
+                int n = min(batch, count - i);
+                for (int j = 0; j < n; j++){
+                    const Post& post = posts[i + j];
+                    fields[5 * j] = post.getPostID();
+                    fields[5 * j + 1] = post.getNumLikes();
+                    fields[5 * j + 2] = post.getConnectLevel();
+                    fields[5 * j + 3] = post.getPostTime();
+                    fields[5 * j + 4] = post.getInterestLevel();
+                }
+                if (write(sockets[1], fields, n * 5 * sizeof(int)) < 0) break;
+            }
+        }
+        _exit(0);
+    }
+
+    long long checksum = 0;
+    int received = 0;
+    if (shared){
+        Post popped[batch];
+        while (received < count){
+            int taken = queue->getNextPosts(popped, batch);
+            if (taken == 0) sched_yield();
+            for (int j = 0; j < taken; j++)
+                checksum += popped[j].getPostID();
+            received += taken;
+        }
+    }
+    else{
+        close(sockets[1]);
+        SQueue local(priorityFn1, MAXHEAP, LEFTIST);
+        vector<int> fields(batch * 5);
+        size_t pendingBytes = 0;
+        while (received < count){
+            ssize_t bytes = read(sockets[0], (char*)fields.data() + pendingBytes, fields.size() * sizeof(int) - pendingBytes);
+            if (bytes <= 0) break;
+            pendingBytes += bytes;
+            int n = (int)(pendingBytes / (5 * sizeof(int)));
+            for (int j = 0; j < n; j++)
+                local.insertPost(Post(fields[5 * j], fields[5 * j + 1], fields[5 * j + 2], fields[5 * j + 3], fields[5 * j + 4]));
+            memmove(fields.data(), (char*)fields.data() + n * 5 * sizeof(int), pendingBytes - n * 5 * sizeof(int));
+            pendingBytes -= n * 5 * sizeof(int);
+            while (local.numPosts() > 0){
+                checksum += local.getNextPost().getPostID();
+                received++;
+            }
+        }
+        close(sockets[0]);
+    }
+    waitpid(child, nullptr, 0);
+    double ms = elapsedMs(start);
+    cout << count / ms / 1000 << " M posts/s (checksum " << checksum << ")\n";
+    if (shared){
+        delete queue;
+        SharedSQueue::unlink(name);
+    }
+}
+
+// Generates count posts with the mt19937 PostGen or with WorkloadGen
+void benchGeneration(bool workload, int count){
+    WorkloadConfig config;
+    config.m_likes = ZIPFDIST;
+    config.m_time = BURSTYDIST;
+    PostGen postGen;
+    WorkloadGen workloadGen(config);
+    uint64_t checksum = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; i++)
+        checksum += (workload ? workloadGen.getPost() : postGen.getPost()).getPayload();
+    double ms = elapsedMs(start);
+    cout << count / ms / 1000 << " M posts/s (checksum " << checksum % 1000 << ")\n";
+}
+
+// The operation mix of a steady feed: as many posts popped as inserted one by one
+// or melded in batches of 8, and a rare switch to priorityFn2, which rebuilds the queue
+WorkloadConfig feedMix(bool skewed){
+    WorkloadConfig config;
+    if (skewed){
+        config.m_likes = ZIPFDIST;
+        config.m_time = BURSTYDIST;
+    }
+    config.m_inserts = 5000;
+    config.m_pops = 5800;
+    config.m_merges = 100;
+    config.m_reprioritizations = 1;
+    config.m_baseFn = priorityFn1;
+    config.m_baseHeapType = MAXHEAP;
+    config.m_altFn = priorityFn2;
+    return config;
+}
+
+// Applies count operations of the feed mix to a queue of size posts
+void benchWorkload(STRUCTURE structure, bool skewed, int size, int count){
+    SQueue queue(priorityFn1, MAXHEAP, structure);
+    WorkloadGen gen(feedMix(skewed));
+    for (int i = 0; i < size; i++)
+        queue.insertPost(gen.getPost());
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    uint64_t checksum = gen.run(queue, count);
+    double ms = elapsedMs(start);
+    cout << count / ms / 1000 << " M ops/s, " << queue.numPosts() << " posts left (checksum " << checksum % 1000 << ")\n";
+}
+
+// Runs count operations of the skewed feed mix on a queue of size posts without
+// and with a recorder, then replays the trace
+void benchTrace(int size, int count){
+    string path = "/tmp/squeue_bench_trace";
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    {
+        SQueue queue(priorityFn1, MAXHEAP, LEFTIST);
+        WorkloadGen gen(feedMix(true));
+        for (int i = 0; i < size; i++)
+            queue.insertPost(gen.getPost());
+        gen.run(queue, count);
+    }
+    double plainMs = elapsedMs(start);
+
+    long long records;
+    vector<prifn_t> functions;
+    start = std::chrono::steady_clock::now();
+    {
+        TraceRecorder recorder(path);
+        SQueue queue(priorityFn1, MAXHEAP, LEFTIST);
+        WorkloadGen gen(feedMix(true));
+        for (int i = 0; i < size; i++)
+            queue.insertPost(gen.getPost());
+        gen.run(queue, count);
+        records = recorder.numRecords();
+        functions = recorder.getFunctions();
+    }
+    double recordMs = elapsedMs(start);
+    ifstream trace(path, ios::binary | ios::ate);
+    long long bytes = trace.tellg();
+
+    TraceReplayer replayer(path, functions);
+    start = std::chrono::steady_clock::now();
+    replayer.replay();
+    double replayMs = elapsedMs(start);
+    remove(path.c_str());
+    cout << "  plain: " << plainMs << " ms  recorded: " << recordMs << " ms  replayed: " << replayMs
+         << " ms (" << records / replayMs / 1000 << " M calls/s)\n";
+    cout << "  trace: " << records << " calls, " << (double)bytes / records << " bytes/call\n";
+}
+
+// Inserts count posts and drains them, in an SQueue or in an ExternalSQueue
+// whose front holds memoryPosts posts and whose runs live in directory
+void benchExternal(bool external, const string& directory, int memoryPosts, int count){
+    WorkloadGen gen((WorkloadConfig()));
+    uint64_t checksum = 0;
+    double insertMs, popMs;
+    long long written = 0, read = 0;
+    int runs = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (external){
+        ExternalSQueue queue(priorityFn1, MAXHEAP, directory, memoryPosts);
+        for (int i = 0; i < count; i++)
+            queue.insertPost(gen.getPost());
+        insertMs = elapsedMs(start);
+        runs = queue.numRuns();
+        start = std::chrono::steady_clock::now();
+        while (queue.numPosts() > 0)
+            checksum = checksum * 31 + queue.getNextPost().getPostID();
+        popMs = elapsedMs(start);
+        written = queue.getBytesWritten();
+        read = queue.getBytesRead();
+    }
+    else{
+        SQueue queue(priorityFn1, MAXHEAP, LEFTIST);
+        for (int i = 0; i < count; i++)
+            queue.insertPost(gen.getPost());
+        insertMs = elapsedMs(start);
+        start = std::chrono::steady_clock::now();
+        while (queue.numPosts() > 0)
+            checksum = checksum * 31 + queue.getNextPost().getPostID();
+        popMs = elapsedMs(start);
+    }
+    cout << "insert " << count / insertMs / 1000 << " M posts/s, drain " << count / popMs / 1000 << " M posts/s";
+    if (external)
+        cout << ", " << runs << " runs, " << written / 1048576.0 << " MB written, " << read / 1048576.0
+             << " MB read (" << (double)(written + read) / count << " bytes/post)";
+    cout << " (checksum " << checksum % 1000 << ")\n";
+}
+
+// Consolidates a PAIRING MINHEAP queue of size posts ordered by priorityFn2 into a
+// LEFTIST MAXHEAP queue of size posts ordered by priorityFn1: by draining and
+// re-inserting it, or with a converting merge
+void benchConvertingMerge(bool convert, int size){
+    WorkloadGen gen((WorkloadConfig()));
+    SQueue target(priorityFn1, MAXHEAP, LEFTIST);
+    SQueue source(priorityFn2, MINHEAP, PAIRING);
+    for (int i = 0; i < size; i++){
+        target.insertPost(gen.getPost());
+        source.insertPost(gen.getPost());
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (convert)
+        target.mergeWithQueue(source, true);
+    else
+        while (source.numPosts() > 0)
+            target.insertPost(source.getNextPost());
+    double ms = elapsedMs(start);
+    cout << ms << " ms, " << target.numPosts() << " posts\n";
+}
+
+int main() {
+    const char* names[] = {"SKEW", "LEFTIST", "PAIRING"};
+    STRUCTURE structures[] = {SKEW, LEFTIST, PAIRING};
+
+    cout << "Merge-heavy, pop-light (20000 queues x 8 posts, 10 pops):\n";
+    for (int s = 0; s < 2; s++){
+        cout << "  " << names[s]
+             << "  eager: " << benchMergeHeavy(structures[s], false, 20000, 8, 10) << " ms"
+             << "  lazy: " << benchMergeHeavy(structures[s], true, 20000, 8, 10) << " ms\n";
+    }
+    cout << "Merge-heavy, pop-heavy (20000 queues x 8 posts, 80000 pops):\n";
+    for (int s = 0; s < 2; s++){
+        cout << "  " << names[s]
+             << "  eager: " << benchMergeHeavy(structures[s], false, 20000, 8, 80000) << " ms"
+             << "  lazy: " << benchMergeHeavy(structures[s], true, 20000, 8, 80000) << " ms\n";
+    }
+    const char* autoNames[] = {"SKEW", "LEFTIST", "PAIRING", "AUTO"};
+    STRUCTURE autoStructures[] = {SKEW, LEFTIST, PAIRING, AUTO};
+    cout << "Insert-heavy with melds (20000 rounds x 16 inserts, 1 pop per round, then drain):\n";
+    for (int s = 0; s < 4; s++)
+        cout << "  " << autoNames[s] << ": " << benchInsertMeld(autoStructures[s], 20000, 16) << " ms\n";
+    const char* minNames[] = {"SKEW", "LEFTIST", "PAIRING", "RADIX", "AUTO"};
+    STRUCTURE minStructures[] = {SKEW, LEFTIST, PAIRING, RADIX, AUTO};
+    cout << "Monotone MINHEAP pop/insert (100000 posts, 100000 rounds):\n";
+    for (int s = 0; s < 5; s++)
+        cout << "  " << minNames[s] << ": " << benchMonotone(minStructures[s], 100000, 100000) << " ms\n";
+    cout << "Drifting mix (125000 melds of 8 posts, then 500000 pop/insert pairs, then drain):\n";
+    for (int s = 0; s < 4; s++)
+        cout << "  " << autoNames[s] << ": " << benchDrift(autoStructures[s], 1000000, 500000) << " ms\n";
+    cout << "A day of ticking time (100000 posts, 1440 ticks, 500 inserts/pops per tick):\n";
+    cout << "  rebuild every tick: " << benchDecayDay(false, 100000, 1440, 500) << " ms\n";
+    cout << "  decay-aware epochs: " << benchDecayDay(true, 100000, 1440, 500) << " ms\n";
+    cout << "Bulk insert and re-prioritization (1000000 posts):\n";
+    cout << "  insertPost + priority function:  "; benchLinearPriority(0, 1000000);
+    cout << "  insertPosts + priority function: "; benchLinearPriority(1, 1000000);
+    cout << "  insertPosts + linear model:      "; benchLinearPriority(2, 1000000);
+    cout << "Whole-tree operations across thread counts (2000000 posts):\n";
+    for (int threads = 1; threads <= 8; threads *= 2)
+        benchThreads(threads, 2000000);
+    cout << "Feed preview (1000000 posts):\n";
+    benchTopK(1000000, 10);
+    benchTopK(1000000, 1000);
+    cout << "Zipf multi-tenant workload (1000000 users, 3000000 posts):\n";
+    benchTenants(1000000, 3000000);
+    cout << "Three slice consumers draining 1000000 posts:\n";
+    benchPartitions(1000000);
+    cout << "Consumer wake-up (2000 posts, one every 200 us):\n";
+    cout << "  polling SQueue:    "; benchWakeup(false, 2000, 200);
+    cout << "  co_await next():   "; benchWakeup(true, 2000, 200);
+    cout << "Export of 1000000 posts to /dev/null:\n";
+    benchExport(1000000);
+    cout << "Footprint and pop throughput (1000000 posts, sizeof(Post) = " << sizeof(Post) << "):\n";
+    for (int s = 0; s < 3; s++){
+        cout << "  " << names[s] << ": ";
+        benchFootprint(structures[s], 1000000);
+    }
+    cout << "Feed capped at 100 posts, 100000 posts arriving:\n";
+    cout << "  drain and rebuild SQueue: "; benchBounded(false, 100, 100000);
+    cout << "  BoundedSQueue:            "; benchBounded(true, 100, 100000);
+    cout << "Producer process to consumer process (1000000 posts):\n";
+    cout << "  socket + local SQueue: "; benchTwoProcess(false, 1000000);
+    cout << "  SharedSQueue:          "; benchTwoProcess(true, 1000000);
+    cout << "Approximate pops (1000000 posts, 1000000 pop/insert rounds):\n";
+    cout << "  SKEW (exact):               "; benchApproximate(SKEW, 0, 1000000, 1000000);
+    cout << "  LEFTIST (exact):            "; benchApproximate(LEFTIST, 0, 1000000, 1000000);
+    double errorRates[] = {0.01, 0.1, 0.5};
+    for (int e = 0; e < 3; e++){
+        cout << "  SoftSQueue, error rate " << errorRates[e] << (errorRates[e] < 0.1 ? ": " : ":  ");
+        benchApproximate(SKEW, errorRates[e], 1000000, 1000000);
+    }
+    cout << "Post generation (10000000 posts):\n";
+    cout << "  PostGen (mt19937, uniform):      "; benchGeneration(false, 10000000);
+    cout << "  WorkloadGen (Zipf likes, bursts): "; benchGeneration(true, 10000000);
+    cout << "Steady feed of 100000 posts, 2000000 inserts, pops, melds and re-prioritizations:\n";
+    cout << "  LEFTIST, uniform posts:     "; benchWorkload(LEFTIST, false, 100000, 2000000);
+    cout << "  LEFTIST, Zipf and bursty:   "; benchWorkload(LEFTIST, true, 100000, 2000000);
+    cout << "  PAIRING, uniform posts:     "; benchWorkload(PAIRING, false, 100000, 2000000);
+    cout << "  PAIRING, Zipf and bursty:   "; benchWorkload(PAIRING, true, 100000, 2000000);
+    cout << "  AUTO, Zipf and bursty:      "; benchWorkload(AUTO, true, 100000, 2000000);
+    cout << "Trace record and replay of the Zipf and bursty feed (100000 posts, 2000000 operations):\n";
+    benchTrace(100000, 2000000);
+    cout << "Insert then drain 10000000 posts, runs on the local disk:\n";
+    cout << "  SQueue in memory:                   "; benchExternal(false, ".", 0, 10000000);
+    cout << "  ExternalSQueue, 1048576-post front: "; benchExternal(true, ".", 1 << 20, 10000000);
+    cout << "  ExternalSQueue, 131072-post front:  "; benchExternal(true, ".", 1 << 17, 10000000);
+    cout << "Consolidating a differently configured queue (1000000 + 1000000 posts):\n";
+    cout << "  drain and re-insert: "; benchConvertingMerge(false, 1000000);
+    cout << "  converting merge:    "; benchConvertingMerge(true, 1000000);
+    cout << "Teardown of 1000000 posts:\n";
+    cout << "  on the calling thread: "; benchTeardown(false, 1000000);
+    cout << "  deferred:              "; benchTeardown(true, 1000000);
+    return 0;
+}
+
+/* Priority functions */
+// Priority function 1: Calculates priority based on likes and interest level
+int priorityFn1(const Post & post) {
+    int priority = post.getNumLikes() + post.getInterestLevel();
+    if (priority >= 1 && priority <= 510)
+        return priority;
+    return 0; // This indicates an invalid Post object for ordering
+}
+
+// Priority function 2: Calculates priority based on post time and connection level
+int priorityFn2(const Post & post) {
+    int priority = post.getPostTime() + post.getConnectLevel();
+    if (priority >= 2 && priority <= 55)
+        return priority;
+    return 0; // This indicates an invalid Post object for ordering
+}
@@ -1,8 +1,22 @@
 #include "squeue.h"
+#include "queuemanager.h"
+#include "partitionedqueue.h"
+#include "asyncqueue.h"
+#include "boundedsqueue.h"
+#include "sharedsqueue.h"
+#include "softsqueue.h"
+#include "workload.h"
+#include "externalsqueue.h"
+#include <sys/wait.h>
+#include <unistd.h>
+#include <thread>
 #include <math.h>
 #include <algorithm>
 #include <random>
 #include <vector>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
 
 using namespace std;
 
@@ -13,123 +27,48 @@ class Tester{
     bool testMaxHeapInsertion();
     bool testMaxHeapRemoval();
     bool testMergeWithQueueEdgeCase();
+    bool testLazyMerge();
+    bool testPairingHeap();
+    bool testRadixHeap();
+    bool testTimeDecay();
+    bool testLinearPriority();
+    bool testParallelTreeOperations();
+    bool testOrderedIteration();
+    bool testQueueManager();
+    bool testPartitionedQueue();
+    bool testAsyncQueue();
+    bool testExport();
+    bool testTeardown();
+    bool testPackedPost();
+    bool testBoundedQueue();
+    bool minMaxProperty(const BoundedSQueue& queue);
+    bool testSharedQueue();
+    bool testAdaptiveStructure();
+    bool testSoftQueue();
+    bool testTraceReplay();
+    bool testExternalQueue();
+    bool testConvertingMerge();
+    void expectedText(SQueue& queue, Post* root, ostringstream& out);
 
     
 
     //helper function to check properties
     bool testProperty(Post* root, prifn_t priorityFunc, HEAPTYPE type, STRUCTURE structure);
+    //helper function to check that two trees have the same shape and posts
+    bool sameTree(Post* root1, Post* root2);
     
 };
 
-//random class for testing data
-enum RANDOM {UNIFORMINT, UNIFORMREAL, NORMAL, SHUFFLE};
-class Random {
-public:
-    Random(){}
-    Random(int min, int max, RANDOM type=UNIFORMINT, int mean=50, int stdev=20) : m_min(min), m_max(max), m_type(type)
-    {
-        if (type == NORMAL){
-            //the case of NORMAL to generate integer numbers with normal distribution
-            m_generator = std::mt19937(m_device());
-            m_normdist = std::normal_distribution<>(mean,stdev);
-        }
-        else if (type == UNIFORMINT) {
-            m_generator = std::mt19937(10);// 10 is the fixed seed value
-            m_unidist = std::uniform_int_distribution<>(min,max);
-        }
-        else if (type == UNIFORMREAL) { //the case of UNIFORMREAL to generate real numbers
-            m_generator = std::mt19937(10);// 10 is the fixed seed value
-            m_uniReal = std::uniform_real_distribution<double>((double)min,(double)max);
-        }
-        else { //the case of SHUFFLE to generate every number only once
-            m_generator = std::mt19937(m_device());
-        }
-    }
-    void setSeed(int seedNum){
-        m_generator = std::mt19937(seedNum);
-    }
-    void init(int min, int max){
-        m_min = min;
-        m_max = max;
-        m_type = UNIFORMINT;
-        m_generator = std::mt19937(10);// 10 is the fixed seed value
-        m_unidist = std::uniform_int_distribution<>(min,max);
-    }
-    void getShuffle(vector<int> & array){
-        // this function provides a list of all values between min and max
-        for (int i = m_min; i<=m_max; i++){
-            array.push_back(i);
-        }
-        shuffle(array.begin(),array.end(),m_generator);
-    }
-
-    void getShuffle(int array[]){
-        // this function provides a list of all values between min and max
-        vector<int> temp;
-        for (int i = m_min; i<=m_max; i++){
-            temp.push_back(i);
-        }
-        std::shuffle(temp.begin(), temp.end(), m_generator);
-        vector<int>::iterator it;
-        int i = 0;
-        for (it=temp.begin(); it != temp.end(); it++){
-            array[i] = *it;
-            i++;
-        }
-    }
-
-    int getRandNum(){
-        // this function returns integer numbers
-        // the object must have been initialized to generate integers
-        int result = 0;
-        if(m_type == NORMAL){
-            //returns a random number in a set with normal distribution
-            //we limit random numbers by the min and max values
-            result = m_min - 1;
-            while(result < m_min || result > m_max)
-                result = m_normdist(m_generator);
-        }
-        else if (m_type == UNIFORMINT){
-            //this will generate a random number between min and max values
-            result = m_unidist(m_generator);
-        }
-        return result;
-    }
-
-    double getRealRandNum(){
-        // this function returns real numbers
-        // the object must have been initialized to generate real numbers
-        double result = m_uniReal(m_generator);
-        result = std::floor(result*100.0)/100.0;
-        return result;
-    }
-
-    string getRandString(int size){
-        // the parameter size specifies the length of string we ask for
-        string output = "";
-        for (int i=0;i<size;i++){
-            output = output + (char)getRandNum();
-        }
-        return output;
-    }
-    
-    int getMin(){return m_min;}
-    int getMax(){return m_max;}
-    private:
-    int m_min;
-    int m_max;
-    RANDOM m_type;
-    std::random_device m_device;
-    std::mt19937 m_generator;
-    std::normal_distribution<> m_normdist;//normal distribution
-    std::uniform_int_distribution<> m_unidist;//integer uniform distribution
-    std::uniform_real_distribution<double> m_uniReal;//real uniform distribution
-
-};
-
 //priority functions
 int priorityFn1(const Post &post);// works with a MAXHEAP
 int priorityFn2(const Post &post);// works with a MINHEAP
+int priorityById(const Post &post);// newer (higher) post IDs first with a MAXHEAP
+//partition function: high-connection posts (level 1-2) go to partition 0
+int connectionPartition(const Post &post){ return post.getConnectLevel() <= 2 ? 0 : 1; }
+//coroutines driving an AsyncQueue
+AsyncTask consumePosts(AsyncQueue &queue, vector<int> &likes, bool &done);
+AsyncTask consumeBatches(AsyncQueue &queue, int k, vector<int> &sizes, bool &done);
+AsyncTask producePosts(AsyncQueue &queue, int count, int &pushed, bool &done);
 
 
 //function to check heap properties
@@ -264,6 +203,11 @@ int priorityFn2(const Post & post) {
     else
         return 0; // this is an invalid order object
 }
+int priorityById(const Post & post) {
+    //needs MAXHEAP
+    //the newest post has the highest priority
+    return post.getPostID();
+}
 
 //test whether the heap properties are conserved after several insertion in a minheap
 bool Tester::testMinHeapInsertion(){
@@ -376,6 +320,1361 @@ bool Tester::testMergeWithQueueEdgeCase(){
 
 }
 
+//test that lazily merged queues pop in the same order as eagerly merged ones
+bool Tester::testLazyMerge(){
+    Random idGen(MINPOSTID,MAXPOSTID);
+    Random likesGen(MINLIKES,MAXLIKES);
+    Random timeGen(MINTIME,MAXTIME);
+    Random conLevelGen(MINCONLEVEL,MAXCONLEVEL);
+    Random interestGen(MININTERESTLEVEL,MAXINTERESTLEVEL);
+    SQueue eager(priorityFn2, MINHEAP, SKEW);
+    SQueue lazy(priorityFn2, MINHEAP, SKEW);
+    lazy.setLazyMerge(true);
+    for (int i=0;i<20;i++){
+        SQueue part1(priorityFn2, MINHEAP, SKEW);
+        SQueue part2(priorityFn2, MINHEAP, SKEW);
+        for (int j=0;j<15;j++){
+            Post myPost(idGen.getRandNum(),
+                        likesGen.getRandNum(),
+                        conLevelGen.getRandNum(),
+                        timeGen.getRandNum(),
+                        interestGen.getRandNum());
+            part1.insertPost(myPost);
+            part2.insertPost(myPost);
+        }
+        eager.mergeWithQueue(part1);
+        lazy.mergeWithQueue(part2);
+    }
+    if (lazy.numPosts() != 300 || lazy.m_pending.size() != 20)
+        return false;
+    if (priorityFn2(lazy.peekNextPost()) != priorityFn2(eager.peekNextPost()) || !lazy.m_pending.empty())
+        return false;
+    if (!testProperty(lazy.m_heap, lazy.m_priorFunc, lazy.m_heapType, lazy.m_structure))
+        return false;
+    int last = 0;
+    while (lazy.numPosts() > 0){
+        int priority = priorityFn2(lazy.getNextPost());
+        if (priority < last || priority != priorityFn2(eager.getNextPost()))
+            return false;
+        last = priority;
+    }
+    return true;
+}
+//test the pairing heap: removal order, merging and conversion to the other structures
+bool Tester::testPairingHeap(){
+    Random idGen(MINPOSTID,MAXPOSTID);
+    Random likesGen(MINLIKES,MAXLIKES);
+    Random timeGen(MINTIME,MAXTIME);
+    Random conLevelGen(MINCONLEVEL,MAXCONLEVEL);
+    Random interestGen(MININTERESTLEVEL,MAXINTERESTLEVEL);
+    SQueue tree(priorityFn1, MAXHEAP, PAIRING);
+    SQueue other(priorityFn1, MAXHEAP, PAIRING);
+    for (int i=0;i<300;i++){
+        Post myPost(idGen.getRandNum(),
+                    likesGen.getRandNum(),
+                    conLevelGen.getRandNum(),
+                    timeGen.getRandNum(),
+                    interestGen.getRandNum());
+        if (i % 2 == 0)
+            tree.insertPost(myPost);
+        else
+            other.insertPost(myPost);
+    }
+    tree.mergeWithQueue(other);
+    for (int i=0;i<10;i++)
+        tree.getNextPost();
+
+    //round trip through the binary structures
+    tree.setStructure(LEFTIST);
+    if (!testProperty(tree.m_heap, tree.m_priorFunc, tree.m_heapType, tree.m_structure))
+        return false;
+    tree.setStructure(PAIRING);
+    tree.setStructure(SKEW);
+    if (!testProperty(tree.m_heap, tree.m_priorFunc, tree.m_heapType, tree.m_structure))
+        return false;
+    tree.setStructure(PAIRING);
+
+    SQueue copy(tree);
+    int last = MAXLIKES + MAXINTERESTLEVEL;
+    while (tree.numPosts() > 0){
+        int priority = priorityFn1(tree.getNextPost());
+        if (priority > last || priority != priorityFn1(copy.getNextPost()))
+            return false;
+        last = priority;
+    }
+    if (copy.numPosts() != 0)
+        return false;
+
+    //posts inserted in priority order make a chain of 300000 first children;
+    //copying and reprioritizing it must not recurse along the chain
+    SQueue chain(priorityById, MAXHEAP, PAIRING);
+    for (int i=0;i<300000;i++)
+        chain.insertPost(Post(MINPOSTID + i, MINLIKES, MINCONLEVEL, MINTIME, MININTERESTLEVEL));
+    SQueue chainCopy(chain);
+    SQueue assigned(priorityFn1, MAXHEAP, PAIRING);
+    assigned = chain;
+    chainCopy.setPriorityFn(priorityById, MINHEAP);
+    if (chainCopy.getNextPost().getPostID() != MINPOSTID || assigned.getNextPost().getPostID() != MINPOSTID + 299999)
+        return false;
+    chain.setStructure(LEFTIST);
+    chain.setStructure(PAIRING);
+    return chain.getNextPost().getPostID() == MINPOSTID + 299999 && chainCopy.numPosts() == 299999;
+}
+//test the monotone radix heap: removal order, contract violations and conversions
+bool Tester::testRadixHeap(){
+    Random idGen(MINPOSTID,MAXPOSTID);
+    Random likesGen(MINLIKES,MAXLIKES);
+    Random timeGen(MINTIME,MAXTIME);
+    Random conLevelGen(MINCONLEVEL,MAXCONLEVEL);
+    Random interestGen(MININTERESTLEVEL,MAXINTERESTLEVEL);
+    SQueue tree(priorityFn2, MINHEAP, RADIX);
+    for (int i=0;i<300;i++){
+        Post myPost(idGen.getRandNum(),
+                    likesGen.getRandNum(),
+                    conLevelGen.getRandNum(),
+                    timeGen.getRandNum(),
+                    interestGen.getRandNum());
+        tree.insertPost(myPost);
+    }
+    int last = 0;
+    for (int i=0;i<150;i++){
+        int priority = priorityFn2(tree.getNextPost());
+        if (priority < last)
+            return false;
+        last = priority;
+    }
+
+    //a post below the last extracted priority breaks the monotone contract
+    bool rejected = false;
+    try{
+        tree.insertPost(Post(MINPOSTID, MINLIKES, MINCONLEVEL, MINTIME, MININTERESTLEVEL));
+    }
+    catch(domain_error &e){
+        rejected = true;
+    }
+    if (!rejected || tree.numPosts() != 150)
+        return false;
+    if (!tree.insertPost(Post(MINPOSTID, MINLIKES, MAXCONLEVEL, MAXTIME, MININTERESTLEVEL)))
+        return false;
+
+    //round trip through a binary structure
+    tree.setStructure(LEFTIST);
+    if (!testProperty(tree.m_heap, tree.m_priorFunc, tree.m_heapType, tree.m_structure))
+        return false;
+    tree.setStructure(RADIX);
+    while (tree.numPosts() > 0){
+        int priority = priorityFn2(tree.getNextPost());
+        if (priority < last)
+            return false;
+        last = priority;
+    }
+
+    //another MINHEAP function rekeys the radix heap in place; a MAXHEAP is rejected
+    SQueue byId(priorityFn2, MINHEAP, RADIX);
+    for (int i=0;i<300;i++)
+        byId.insertPost(Post(MINPOSTID + (i * 7) % 300, likesGen.getRandNum(), conLevelGen.getRandNum(),
+                             timeGen.getRandNum(), MININTERESTLEVEL));
+    byId.getNextPost();
+    byId.setPriorityFn(priorityById, MINHEAP);
+    if (byId.getStructure() != RADIX || byId.getPriorityFn() != priorityById || byId.numPosts() != 299)
+        return false;
+    last = 0;
+    while (byId.numPosts() > 0){
+        int id = byId.getNextPost().getPostID();
+        if (id < last)
+            return false;
+        last = id;
+    }
+    try{
+        byId.setPriorityFn(priorityFn1, MAXHEAP);
+        return false;
+    }
+    catch (runtime_error &e){
+        return true;
+    }
+}
+//test that decayed priorities order posts of different ages without rebuilding
+bool Tester::testTimeDecay(){
+    SQueue tree(priorityFn1, MAXHEAP, LEFTIST);
+    tree.setDecay(4);
+    Post oldPost(MINPOSTID, 396, MINCONLEVEL, MINTIME, 4);      //priority 400
+    Post newPost(MINPOSTID + 1, 196, MINCONLEVEL, MINTIME, 4);  //priority 200
+    tree.insertPost(oldPost);
+    tree.advanceEpoch(8); //the old post decays to 100
+    tree.insertPost(newPost);
+    if (tree.peekNextPost().getPostID() != MINPOSTID + 1)
+        return false;
+    if (tree.decayedPriority(tree.peekNextPost()) != 200)
+        return false;
+    tree.getNextPost();
+    if (tree.decayedPriority(tree.peekNextPost()) != 100)
+        return false;
+
+    //turning decay off restores the static order
+    tree.insertPost(newPost);
+    tree.setDecay(0);
+    if (tree.getNextPost().getPostID() != MINPOSTID ||
+        !testProperty(tree.m_heap, tree.m_priorFunc, tree.m_heapType, tree.m_structure))
+        return false;
+
+    //a merge keeps the age of the merged posts when the queues' epochs differ: a
+    //post just inserted into a queue at epoch 100 is not older than zero here
+    SQueue target(priorityFn1, MAXHEAP, LEFTIST), later(priorityFn1, MAXHEAP, LEFTIST);
+    target.setDecay(4);
+    later.setDecay(4);
+    target.insertPost(oldPost);                 //priority 400 at epoch 0
+    later.advanceEpoch(100);
+    later.insertPost(Post(MINPOSTID + 2, 96, MINCONLEVEL, MINTIME, 4));   //priority 100 at epoch 100
+    later.insertPost(Post(MINPOSTID + 3, 46, MINCONLEVEL, MINTIME, 4));   //priority 50
+    target.mergeWithQueue(later);
+    if (target.peekNextPost().getPostID() != MINPOSTID || target.decayedPriority(target.peekNextPost()) != 400)
+        return false;
+    target.getNextPost();
+    if (target.decayedPriority(target.peekNextPost()) != 100 ||
+        !testProperty(target.m_heap, target.m_priorFunc, target.m_heapType, target.m_structure))
+        return false;
+
+    //negative priorities of a model decay like a priority of 1, after every positive one
+    SQueue scored(LinearPriority(1, 0, 0, 0, -100, -100, MAXLIKES), MAXHEAP, LEFTIST);
+    scored.setDecay(4);
+    scored.insertPost(Post(MINPOSTID, 50, MINCONLEVEL, MINTIME, MININTERESTLEVEL));       //priority -50
+    scored.insertPost(Post(MINPOSTID + 1, 150, MINCONLEVEL, MINTIME, MININTERESTLEVEL));  //priority 50
+    scored.advanceEpoch(8);
+    scored.insertPost(Post(MINPOSTID + 2, 10, MINCONLEVEL, MINTIME, MININTERESTLEVEL));   //priority -90
+    scored.insertPost(Post(MINPOSTID + 3, 300, MINCONLEVEL, MINTIME, MININTERESTLEVEL));  //priority 200
+    if (scored.getNextPost().getPostID() != MINPOSTID + 3 || scored.getNextPost().getPostID() != MINPOSTID + 1)
+        return false;
+    //the newer of the two negative posts has decayed less
+    return scored.getNextPost().getPostID() == MINPOSTID + 2 && scored.getNextPost().getPostID() == MINPOSTID;
+}
+//test that a linear priority model orders bulk inserted posts like the matching priority function
+bool Tester::testLinearPriority(){
+    Random idGen(MINPOSTID,MAXPOSTID);
+    Random likesGen(MINLIKES,MAXLIKES);
+    Random timeGen(MINTIME,MAXTIME);
+    Random conLevelGen(MINCONLEVEL,MAXCONLEVEL);
+    Random interestGen(MININTERESTLEVEL,MAXINTERESTLEVEL);
+    LinearPriority model1(1, 0, 0, 1, 0, 1, 510);   //same as priorityFn1
+    LinearPriority model2(0, 1, 1, 0, 0, 2, 55);    //same as priorityFn2
+    SQueue byFunction(priorityFn1, MAXHEAP, LEFTIST);
+    SQueue byModel(model1, MAXHEAP, LEFTIST);
+    vector<Post> posts;
+    for (int i=0;i<301;i++){
+        Post myPost(idGen.getRandNum(),
+                    likesGen.getRandNum(),
+                    conLevelGen.getRandNum(),
+                    timeGen.getRandNum(),
+                    interestGen.getRandNum());
+        posts.push_back(myPost);
+        byFunction.insertPost(myPost);
+    }
+    if (byModel.insertPosts(posts.data(), (int)posts.size()) != 301)
+        return false;
+    if (!testProperty(byModel.m_heap, priorityFn1, byModel.m_heapType, byModel.m_structure))
+        return false;
+
+    //re-prioritization with a model for a MINHEAP
+    byModel.setPriorityModel(model2, MINHEAP);
+    byFunction.setPriorityFn(priorityFn2, MINHEAP);
+    if (!testProperty(byModel.m_heap, priorityFn2, byModel.m_heapType, byModel.m_structure))
+        return false;
+    while (byModel.numPosts() > 0){
+        if (priorityFn2(byModel.getNextPost()) != priorityFn2(byFunction.getNextPost()))
+            return false;
+    }
+    return byFunction.numPosts() == 0;
+}
+bool Tester::sameTree(Post* root1, Post* root2){
+    vector<Post*> stack1, stack2;
+    stack1.push_back(root1);
+    stack2.push_back(root2);
+    while (!stack1.empty()){
+        Post* node1 = stack1.back();
+        Post* node2 = stack2.back();
+        stack1.pop_back();
+        stack2.pop_back();
+        if (!node1 || !node2){
+            if (node1 != node2)
+                return false;
+            continue;
+        }
+        if (node1->getPostID() != node2->getPostID() || node1->m_npl != node2->m_npl)
+            return false;
+        stack1.push_back(node1->m_left);
+        stack1.push_back(node1->m_right);
+        stack2.push_back(node2->m_left);
+        stack2.push_back(node2->m_right);
+    }
+    return true;
+}
+
+//test that multithreaded whole-tree operations give the same trees as the serial ones
+bool Tester::testParallelTreeOperations(){
+    Random idGen(MINPOSTID,MAXPOSTID);
+    Random likesGen(MINLIKES,MAXLIKES);
+    Random timeGen(MINTIME,MAXTIME);
+    Random conLevelGen(MINCONLEVEL,MAXCONLEVEL);
+    Random interestGen(MININTERESTLEVEL,MAXINTERESTLEVEL);
+    SQueue serial(priorityFn1, MAXHEAP, SKEW);
+    for (int i=0;i<100000;i++){
+        Post myPost(idGen.getRandNum(),
+                    likesGen.getRandNum(),
+                    conLevelGen.getRandNum(),
+                    timeGen.getRandNum(),
+                    interestGen.getRandNum());
+        serial.insertPost(myPost);
+    }
+    SQueue parallel(serial);
+    parallel.setThreads(4);
+    SQueue copy(parallel); //parallel deep copy
+    if (!sameTree(serial.m_heap, copy.m_heap))
+        return false;
+
+    serial.setStructure(LEFTIST);
+    copy.setStructure(LEFTIST);
+    serial.setPriorityFn(priorityFn2, MINHEAP);
+    copy.setPriorityFn(priorityFn2, MINHEAP);
+    if (!sameTree(serial.m_heap, copy.m_heap))
+        return false;
+    copy.clear(); //parallel teardown
+    return copy.numPosts() == 0 &&
+           testProperty(serial.m_heap, serial.m_priorFunc, serial.m_heapType, serial.m_structure);
+}
+//test that iteration visits every post in removal order without changing the queue
+bool Tester::testOrderedIteration(){
+    Random idGen(MINPOSTID,MAXPOSTID);
+    Random likesGen(MINLIKES,MAXLIKES);
+    Random timeGen(MINTIME,MAXTIME);
+    Random conLevelGen(MINCONLEVEL,MAXCONLEVEL);
+    Random interestGen(MININTERESTLEVEL,MAXINTERESTLEVEL);
+    STRUCTURE structures[] = {SKEW, LEFTIST, PAIRING, RADIX};
+    for (int s=0;s<4;s++){
+        SQueue tree(priorityFn2, MINHEAP, structures[s]);
+        SQueue part(priorityFn2, MINHEAP, structures[s]);
+        tree.setLazyMerge(structures[s] == SKEW); //the skew queue keeps a pending root
+        for (int i=0;i<300;i++){
+            Post myPost(idGen.getRandNum(),
+                        likesGen.getRandNum(),
+                        conLevelGen.getRandNum(),
+                        timeGen.getRandNum(),
+                        interestGen.getRandNum());
+            if (i < 200)
+                tree.insertPost(myPost);
+            else
+                part.insertPost(myPost);
+        }
+        tree.mergeWithQueue(part);
+        tree.getNextPost(); //a radix heap iterates after its buckets were redistributed
+
+        SQueue copy(tree);
+        int visited = 0;
+        for (SQueue::const_iterator it = tree.begin(); it != tree.end(); ++it){
+            if (priorityFn2(*it) != priorityFn2(copy.getNextPost()))
+                return false;
+            visited++;
+        }
+        if (visited != 299 || tree.numPosts() != 299)
+            return false;
+    }
+    return true;
+}
+//test inline storage, promotion and demotion of per-user queues
+bool Tester::testQueueManager(){
+    Random idGen(MINPOSTID,MAXPOSTID);
+    Random likesGen(MINLIKES,MAXLIKES);
+    Random timeGen(MINTIME,MAXTIME);
+    Random conLevelGen(MINCONLEVEL,MAXCONLEVEL);
+    Random interestGen(MININTERESTLEVEL,MAXINTERESTLEVEL);
+    QueueManager manager(priorityFn1, MAXHEAP, LEFTIST, 16);
+    SQueue small(priorityFn1, MAXHEAP, LEFTIST);
+    SQueue large(priorityFn1, MAXHEAP, LEFTIST);
+    for (int i=0;i<60;i++){
+        Post myPost(idGen.getRandNum(),
+                    likesGen.getRandNum(),
+                    conLevelGen.getRandNum(),
+                    timeGen.getRandNum(),
+                    interestGen.getRandNum());
+        if (i < 10){
+            manager.insertPost(1, myPost);
+            small.insertPost(myPost);
+        }
+        else{
+            manager.insertPost(2, myPost);
+            large.insertPost(myPost);
+        }
+    }
+    if (manager.numQueues() != 2 || manager.isPromoted(1) || !manager.isPromoted(2))
+        return false;
+    if (manager.numPosts(1) != 10 || manager.numPosts(2) != 50)
+        return false;
+    while (small.numPosts() > 0)
+        if (priorityFn1(manager.getNextPost(1)) != priorityFn1(small.getNextPost()))
+            return false;
+    while (large.numPosts() > 0)
+        if (priorityFn1(manager.getNextPost(2)) != priorityFn1(large.getNextPost()))
+            return false;
+
+    //a drained queue is demoted and released arena blocks are reused
+    if (manager.isPromoted(2) || manager.numPosts(1) != 0)
+        return false;
+    manager.insertPost(3, Post(MINPOSTID, MAXLIKES, MINCONLEVEL, MINTIME, MAXINTERESTLEVEL));
+    manager.removeQueue(3);
+    return manager.numQueues() == 2 && manager.m_arenas[0].size() == 1 && manager.m_arenas[4].size() == 32;
+}
+//test routing, per-partition removals and global removals of a partitioned queue
+bool Tester::testPartitionedQueue(){
+    PartitionedQueue queue(priorityFn1, MAXHEAP, LEFTIST, 2, connectionPartition);
+    SQueue reference(priorityFn1, MAXHEAP, LEFTIST);
+    //four producers insert concurrently
+    vector<thread> producers;
+    for (int t=0;t<4;t++){
+        producers.push_back(thread([&queue, t]{
+            Random likesGen(MINLIKES,MAXLIKES);
+            Random conLevelGen(MINCONLEVEL,MAXCONLEVEL);
+            likesGen.setSeed(t);
+            conLevelGen.setSeed(t + 100);
+            for (int i=0;i<250;i++)
+                queue.insertPost(Post(MINPOSTID + t*1000 + i, likesGen.getRandNum(), conLevelGen.getRandNum(), MINTIME, MININTERESTLEVEL));
+        }));
+    }
+    for (int t=0;t<4;t++)
+        producers[t].join();
+    if (queue.numPosts() != 1000)
+        return false;
+
+    //a consumer of partition 0 only sees high-connection posts
+    for (int i=0;i<50;i++)
+        if (queue.getNextPost(0).getConnectLevel() > 2)
+            return false;
+
+    //global removals come out in priority order
+    int last = MAXLIKES + MAXINTERESTLEVEL;
+    while (queue.numPosts() > 0){
+        int priority = priorityFn1(queue.getNextPost());
+        if (priority > last)
+            return false;
+        last = priority;
+    }
+
+    //routing by priority band
+    vector<int> bands;
+    bands.push_back(100);
+    bands.push_back(300);
+    PartitionedQueue banded(priorityFn1, MAXHEAP, SKEW, bands);
+    banded.insertPost(Post(MINPOSTID, 50, MINCONLEVEL, MINTIME, MININTERESTLEVEL));
+    banded.insertPost(Post(MINPOSTID + 1, 200, MINCONLEVEL, MINTIME, MININTERESTLEVEL));
+    banded.insertPost(Post(MINPOSTID + 2, 400, MINCONLEVEL, MINTIME, MININTERESTLEVEL));
+    if (banded.numPartitions() != 3 || banded.numPosts(0) != 1 || banded.numPosts(1) != 1 ||
+        banded.getNextPost(2).getPostID() != MINPOSTID + 2)
+        return false;
+
+    //each partition's only consumer pops without locking while two producers insert;
+    //every post is taken exactly once, by the consumer of its partition
+    PartitionedQueue owned(priorityFn1, MAXHEAP, PAIRING, 2, connectionPartition);
+    const int perProducer = 5000;
+    vector<int> taken(2, 0);
+    bool misrouted = false;
+    vector<thread> workers;
+    for (int t=0;t<2;t++){
+        workers.push_back(thread([&owned, t]{
+            Random likesGen(MINLIKES,MAXLIKES);
+            Random conLevelGen(MINCONLEVEL,MAXCONLEVEL);
+            likesGen.setSeed(t + 10);
+            conLevelGen.setSeed(t + 110);
+            for (int i=0;i<perProducer;i++)
+                owned.insertPost(Post(MINPOSTID + t*perProducer + i, likesGen.getRandNum(), conLevelGen.getRandNum(), MINTIME, MININTERESTLEVEL));
+        }));
+    }
+    atomic<int> remaining(2 * perProducer);
+    for (int c=0;c<2;c++){
+        workers.push_back(thread([&owned, &taken, &misrouted, &remaining, c]{
+            while (remaining.load() > 0){
+                if (owned.numPosts(c) == 0)
+                    continue;
+                if (connectionPartition(owned.consumeNextPost(c)) != c)
+                    misrouted = true;
+                taken[c]++;
+                remaining--;
+            }
+        }));
+    }
+    for (size_t i=0;i<workers.size();i++)
+        workers[i].join();
+    if (misrouted || taken[0] + taken[1] != 2 * perProducer || owned.numPosts() != 0)
+        return false;
+
+    //an owned partition is refused to the locked pops and to other consumers until
+    //its owner releases it
+    PartitionedQueue claimed(priorityFn1, MAXHEAP, LEFTIST, 2, connectionPartition);
+    for (int i=0;i<10;i++)
+        claimed.insertPost(Post(MINPOSTID + i, 10 * i, MINCONLEVEL + i % 5, MINTIME, MININTERESTLEVEL));
+    claimed.consumeNextPost(0);
+    int refusals = 0;
+    thread other([&claimed, &refusals]{
+        try{ claimed.consumeNextPost(0); }
+        catch (domain_error &e){ refusals++; }
+        try{ claimed.releasePartition(0); }
+        catch (domain_error &e){ refusals++; }
+    });
+    other.join();
+    try{ claimed.getNextPost(0); }
+    catch (domain_error &e){ refusals++; }
+    try{ claimed.getNextPost(); }
+    catch (domain_error &e){ refusals++; }
+    claimed.releasePartition(0);
+    if (refusals != 4 || claimed.getNextPost().getNumLikes() != 90 || claimed.numPosts() != 8)
+        return false;
+
+    //global pops racing an owner consumer take a post before the partition is
+    //claimed or are refused; every post is taken exactly once
+    PartitionedQueue mixed(priorityFn1, MAXHEAP, LEFTIST, 2, connectionPartition);
+    const int mixedPosts = 4000;
+    for (int i=0;i<mixedPosts;i++)
+        mixed.insertPost(Post(MINPOSTID + i, i % MAXLIKES, MINCONLEVEL + i % 5, MINTIME, MININTERESTLEVEL));
+    int consumed = 0;
+    atomic<bool> ownerDone(false);
+    thread owner([&mixed, &consumed, &ownerDone]{
+        try{
+            while (mixed.numPosts(0) > 0){
+                mixed.consumeNextPost(0);
+                consumed++;
+            }
+        }
+        catch (out_of_range &e){} //a global pop took the last post before the claim
+        mixed.releasePartition(0);
+        ownerDone = true;
+    });
+    int popped = 0;
+    while (!ownerDone.load()){
+        try{
+            mixed.getNextPost();
+            popped++;
+        }
+        catch (domain_error &e){}
+        catch (out_of_range &e){}
+    }
+    owner.join();
+    while (mixed.numPosts() > 0){
+        mixed.getNextPost();
+        popped++;
+    }
+    if (consumed + popped != mixedPosts)
+        return false;
+
+    //a radix partition would only check the monotone contract long after the insert
+    try{
+        PartitionedQueue radix(priorityFn2, MINHEAP, RADIX, 2, connectionPartition);
+        return false;
+    }
+    catch (domain_error &e){
+        return true;
+    }
+}
+
+//test suspension of consumers on an empty queue and of producers above the high-water mark
+bool Tester::testAsyncQueue(){
+    Executor executor;
+    AsyncQueue queue(priorityFn1, MAXHEAP, LEFTIST, executor, 4);
+    //a consumer on an empty queue suspends instead of throwing
+    vector<int> likes;
+    bool consumerDone = false;
+    consumePosts(queue, likes, consumerDone);
+    if (!likes.empty() || queue.m_consumers.size() != 1)
+        return false;
+    //an arriving post is handed to it and it is resumed by the executor; the posts
+    //that arrive meanwhile are then taken in priority order without suspending
+    queue.insertPost(Post(MINPOSTID, 100, MINCONLEVEL, MINTIME, MININTERESTLEVEL));
+    if (queue.numPosts() != 0)
+        return false;
+    queue.insertPost(Post(MINPOSTID + 1, 50, MINCONLEVEL, MINTIME, MININTERESTLEVEL));
+    queue.insertPost(Post(MINPOSTID + 2, 300, MINCONLEVEL, MINTIME, MININTERESTLEVEL));
+    if (executor.runPending() != 1 || likes.size() != 3 || likes[0] != 100 || likes[1] != 300 || likes[2] != 50)
+        return false;
+    queue.close();
+    executor.runPending();
+    if (!consumerDone)
+        return false;
+
+    //a producer stops at the high-water mark until a consumer makes room
+    AsyncQueue bounded(priorityFn1, MAXHEAP, PAIRING, executor, 4);
+    int pushed = 0;
+    bool producerDone = false;
+    producePosts(bounded, 10, pushed, producerDone);
+    if (pushed != 4 || bounded.numPosts() != 4 || producerDone)
+        return false;
+    vector<int> sizes;
+    bool batchesDone = false;
+    consumeBatches(bounded, 3, sizes, batchesDone);
+    executor.runPending();
+    if (!producerDone || pushed != 10)
+        return false;
+    bounded.close();
+    executor.runPending();
+    int total = 0;
+    for (size_t i = 0; i < sizes.size(); i++){
+        if (sizes[i] < 1 || sizes[i] > 3)
+            return false;
+        total += sizes[i];
+    }
+    Post post;
+    return batchesDone && total == 10 && !bounded.tryNext(post) && !bounded.insertPost(post);
+}
+
+//reference preorder text of a tree, as the recursive printPostsQueue wrote it
+void Tester::expectedText(SQueue& queue, Post* root, ostringstream& out){
+    if (root == nullptr) return;
+    out << "[" << queue.priority(*root) << "] Post#: " << root->getPostID() << ", likes#: " << root->getNumLikes()
+        << ", connect level: " << root->getConnectLevel() << "\n";
+    expectedText(queue, root->m_left, out);
+    expectedText(queue, root->m_right, out);
+}
+
+//test the text, JSON and binary exports, streaming to a file and a very deep tree
+bool Tester::testExport(){
+    Random idGen(MINPOSTID,MAXPOSTID);
+    Random likesGen(MINLIKES,MAXLIKES);
+    Random timeGen(MINTIME,MAXTIME);
+    Random conLevelGen(MINCONLEVEL,MAXCONLEVEL);
+    Random interestGen(MININTERESTLEVEL,MAXINTERESTLEVEL);
+    SQueue queue(priorityFn1, MAXHEAP, LEFTIST);
+    for (int i=0;i<300;i++){
+        Post myPost(idGen.getRandNum(),
+                    likesGen.getRandNum(),
+                    conLevelGen.getRandNum(),
+                    timeGen.getRandNum(),
+                    interestGen.getRandNum());
+        queue.insertPost(myPost);
+    }
+    //the text is unchanged from the recursive version
+    PostSink text;
+    queue.exportPosts(text, TEXT);
+    ostringstream expected;
+    expectedText(queue, queue.m_heap, expected);
+    if (string(text.data(), text.size()) != expected.str())
+        return false;
+
+    PostSink json;
+    queue.exportPosts(json, JSON);
+    string jsonText(json.data(), json.size());
+    if (jsonText[0] != '[' || jsonText.substr(jsonText.size() - 2) != "]\n" ||
+        count(jsonText.begin(), jsonText.end(), '{') != 300)
+        return false;
+
+    //binary: header, then six ints per post in the same order as the text
+    PostSink binary;
+    queue.exportPosts(binary, BINARY);
+    if (binary.size() != 8 + 300 * 6 * sizeof(int) || memcmp(binary.data(), "SQP1", 4) != 0)
+        return false;
+    const int* records = (const int*)(binary.data() + 8);
+    Post* root = queue.m_heap;
+    if (records[0] != queue.priority(*root) || records[1] != root->getPostID())
+        return false;
+
+    //a small buffer streaming to a file flushes many times and writes the same bytes
+    FILE* file = tmpfile();
+    if (file == nullptr)
+        return false;
+    {
+        PostSink fileSink(fileno(file), 64);
+        queue.exportPosts(fileSink, BINARY);
+    }
+    vector<char> readBack(binary.size() + 1);
+    rewind(file);
+    size_t bytes = fread(readBack.data(), 1, readBack.size(), file);
+    fclose(file);
+    if (bytes != binary.size() || memcmp(readBack.data(), binary.data(), bytes) != 0)
+        return false;
+
+    //a pairing heap of equal posts is one long chain; neither export nor dump recurses
+    SQueue deep(priorityFn1, MAXHEAP, PAIRING);
+    for (int i=0;i<200000;i++)
+        deep.insertPost(Post(MINPOSTID, MINLIKES + 1, MINCONLEVEL, MINTIME, MININTERESTLEVEL));
+    PostSink deepText;
+    deep.exportPosts(deepText, TEXT);
+    ostringstream dumped;
+    streambuf* saved = cout.rdbuf(dumped.rdbuf());
+    deep.dump();
+    cout.rdbuf(saved);
+    string dump = dumped.str();
+    return count(deepText.data(), deepText.data() + deepText.size(), '\n') == 200000 &&
+           count(dump.begin(), dump.end(), '(') == 200000 && count(dump.begin(), dump.end(), ')') == 200000;
+}
+
+//test clearing a very deep tree and deferring the teardown to the reclaimer
+bool Tester::testTeardown(){
+    //with decay every newer post outranks the root, so a MAXHEAP pairing heap
+    //becomes a chain of 300000 left children
+    SQueue* deep = new SQueue(priorityFn1, MAXHEAP, PAIRING);
+    deep->setDecay(1);
+    for (int i=0;i<300000;i++){
+        deep->insertPost(Post(MINPOSTID, MINLIKES + 1, MINCONLEVEL, MINTIME, MININTERESTLEVEL));
+        deep->advanceEpoch();
+    }
+    Post* node = deep->m_heap;
+    int depth = 0;
+    while (node){
+        node = node->m_left;
+        depth++;
+    }
+    if (depth != 300000)
+        return false;
+
+    //copies and rekeys of the chain are iterative as well
+    SQueue* copy = new SQueue(*deep);
+    SQueue assigned(priorityFn1, MAXHEAP, PAIRING);
+    assigned = *deep;
+    copy->setDecay(2);
+    assigned.setPriorityFn(priorityFn1, MINHEAP);
+    deep->setStructure(SKEW);
+    if (copy->numPosts() != 300000 || assigned.numPosts() != 300000 ||
+        !testProperty(deep->m_heap, deep->m_priorFunc, deep->m_heapType, deep->m_structure))
+        return false;
+    delete copy;
+    delete deep;
+
+    //deferred clear returns with an empty queue that can be used right away
+    Random likesGen(MINLIKES,MAXLIKES);
+    SQueue queue(priorityFn1, MAXHEAP, LEFTIST);
+    queue.setDeferredClear(true);
+    SQueue* dropped = new SQueue(priorityFn1, MINHEAP, RADIX);
+    dropped->setDeferredClear(true);
+    for (int i=0;i<10000;i++){
+        Post myPost(MINPOSTID + i, likesGen.getRandNum(), MINCONLEVEL, MINTIME, MININTERESTLEVEL);
+        queue.insertPost(myPost);
+        dropped->insertPost(myPost);
+    }
+    queue.clear();
+    delete dropped;
+    if (queue.numPosts() != 0 || queue.m_heap != nullptr || !queue.getDeferredClear())
+        return false;
+    queue.setPriorityFn(priorityFn1, MAXHEAP);
+    queue.insertPost(Post(MINPOSTID, 100, MINCONLEVEL, MINTIME, MININTERESTLEVEL));
+    if (queue.getNextPost().getNumLikes() != 100)
+        return false;
+    SQueue::waitForReclaim();
+    return queue.numPosts() == 0;
+}
+
+//test that packed fields keep their bounds, defaults and values
+bool Tester::testPackedPost(){
+    Post highest(MAXPOSTID, MAXLIKES, MAXCONLEVEL, MAXTIME, MAXINTERESTLEVEL);
+    Post lowest(MINPOSTID, MINLIKES, MINCONLEVEL, MINTIME, MININTERESTLEVEL);
+    Post invalid(MAXPOSTID + 1, MAXLIKES + 1, MINCONLEVEL - 1, MAXTIME + 1, MAXINTERESTLEVEL + 1);
+    Post copy(highest.getPayload());
+    Post defaults;
+    return highest.getPostID() == MAXPOSTID && highest.getNumLikes() == MAXLIKES &&
+           highest.getConnectLevel() == MAXCONLEVEL && highest.getPostTime() == MAXTIME &&
+           highest.getInterestLevel() == MAXINTERESTLEVEL &&
+           lowest.getPostID() == MINPOSTID && lowest.getNumLikes() == MINLIKES &&
+           lowest.getConnectLevel() == MINCONLEVEL && lowest.getPostTime() == MINTIME &&
+           lowest.getInterestLevel() == MININTERESTLEVEL &&
+           invalid.getPayload() == defaults.getPayload() && defaults.getPostID() == DEFAULTPOSTID &&
+           copy.getPayload() == highest.getPayload();
+}
+
+//every post ranks at least as high as its min-level ancestors and at most as high as its max-level ones
+bool Tester::minMaxProperty(const BoundedSQueue& queue){
+    for (int i = 1; i < (int)queue.m_heap.size(); i++)
+        for (int ancestor = (i - 1) / 2; ; ancestor = (ancestor - 1) / 2){
+            int rank = queue.m_heap[ancestor].m_rank;
+            if (BoundedSQueue::isMinLevel(ancestor) ? rank > queue.m_heap[i].m_rank : rank < queue.m_heap[i].m_rank)
+                return false;
+            if (ancestor == 0)
+                break;
+        }
+    return true;
+}
+
+//test that a bounded queue keeps exactly the best posts and removes from both ends in order
+bool Tester::testBoundedQueue(){
+    Random likesGen(MINLIKES,MAXLIKES);
+    Random interestGen(MININTERESTLEVEL,MAXINTERESTLEVEL);
+    HEAPTYPE heapTypes[] = {MAXHEAP, MINHEAP};
+    prifn_t priorities[] = {priorityFn1, priorityFn2};
+    for (int h = 0; h < 2; h++){
+        BoundedSQueue queue(priorities[h], heapTypes[h], 50);
+        vector<int> ranks;
+        for (int i=0;i<300;i++){
+            Post myPost(MINPOSTID + i, likesGen.getRandNum(), MINCONLEVEL, MINTIME, interestGen.getRandNum());
+            queue.insertPost(myPost);
+            int priority = priorities[h](myPost);
+            ranks.push_back(heapTypes[h] == MAXHEAP ? priority : -priority);
+            if (!minMaxProperty(queue))
+                return false;
+        }
+        //the 50 best ranks are kept
+        sort(ranks.begin(), ranks.end());
+        vector<int> kept;
+        for (int i = 0; i < queue.numPosts(); i++)
+            kept.push_back(queue.m_heap[i].m_rank);
+        sort(kept.begin(), kept.end());
+        if (queue.numPosts() != 50 || queue.numEvicted() != 250 || kept != vector<int>(ranks.end() - 50, ranks.end()))
+            return false;
+
+        //shrinking evicts the worst; then the best come out from the top and the worst from the bottom
+        queue.setCapacity(20);
+        if (queue.numPosts() != 20 || queue.peekWorstPost().getPayload() != queue.getWorstPost().getPayload())
+            return false;
+        int best = priorities[h](queue.getNextPost());
+        int worst = priorities[h](queue.getWorstPost());
+        while (queue.numPosts() > 0){
+            int next = priorities[h](queue.getNextPost());
+            if (queue.numPosts() > 0){
+                int last = priorities[h](queue.getWorstPost());
+                if (heapTypes[h] == MAXHEAP ? (last < worst || last > next) : (last > worst || last < next))
+                    return false;
+                worst = last;
+            }
+            if (heapTypes[h] == MAXHEAP ? next > best : next < best)
+                return false;
+            best = next;
+            if (!minMaxProperty(queue))
+                return false;
+        }
+    }
+    //a full queue rejects a post that is not better than its worst one
+    BoundedSQueue full(priorityFn1, MAXHEAP, 1);
+    full.insertPost(Post(MINPOSTID, 100, MINCONLEVEL, MINTIME, MININTERESTLEVEL));
+    return !full.insertPost(Post(MINPOSTID + 1, 100, MINCONLEVEL, MINTIME, MININTERESTLEVEL)) &&
+           full.insertPost(Post(MINPOSTID + 2, 101, MINCONLEVEL, MINTIME, MININTERESTLEVEL)) &&
+           full.peekNextPost().getPostID() == MINPOSTID + 2;
+}
+
+//test a shared-memory queue through two mappings and across a child process
+bool Tester::testSharedQueue(){
+    string name = "/squeue_test_" + to_string(getpid());
+    SharedSQueue::unlink(name);
+    SharedSQueue owner(name, priorityFn1, MAXHEAP, 300);
+    SharedSQueue other(name, priorityFn1);
+    Random likesGen(MINLIKES,MAXLIKES);
+    Random interestGen(MININTERESTLEVEL,MAXINTERESTLEVEL);
+    for (int i=0;i<300;i++)
+        owner.insertPost(Post(MINPOSTID + i, likesGen.getRandNum(), MINCONLEVEL, MINTIME, interestGen.getRandNum()));
+    //the segment is full; the other mapping sees every post and pops them in order
+    if (owner.insertPost(Post(MINPOSTID, MAXLIKES, MINCONLEVEL, MINTIME, MININTERESTLEVEL)) ||
+        other.numPosts() != 300 || other.getHeapType() != MAXHEAP)
+        return false;
+    int last = priorityFn1(other.getNextPost());
+    Post batch[50];
+    while (other.numPosts() > 0){
+        int count = other.getNextPosts(batch, 50);
+        for (int i = 0; i < count; i++){
+            int priority = priorityFn1(batch[i]);
+            if (priority > last)
+                return false;
+            last = priority;
+        }
+    }
+
+    //a child process fills the queue through its own mapping; freed nodes are reused
+    pid_t child = fork();
+    if (child == 0){
+        SharedSQueue producer(name, priorityFn1);
+        for (int i=0;i<300;i++)
+            producer.insertPost(Post(MINPOSTID + i, i % (MAXLIKES + 1), MINCONLEVEL, MINTIME, MININTERESTLEVEL));
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    bool ordered = WIFEXITED(status) && owner.numPosts() == 300;
+    for (int expected = 299; ordered && expected >= 0; expected--)
+        ordered = owner.getNextPost().getNumLikes() == expected;
+    SharedSQueue::unlink(name);
+    try{
+        SharedSQueue missing(name, priorityFn1);
+        return false;
+    }
+    catch (runtime_error&){}
+    return ordered && owner.numPosts() == 0;
+}
+
+//test that an AUTO queue follows its operation mix and reports its decisions
+bool Tester::testAdaptiveStructure(){
+    Random idGen(MINPOSTID,MAXPOSTID);
+    Random likesGen(MINLIKES,MAXLIKES);
+    Random timeGen(MINTIME,MAXTIME);
+    Random conLevelGen(MINCONLEVEL,MAXCONLEVEL);
+    Random interestGen(MININTERESTLEVEL,MAXINTERESTLEVEL);
+
+    //melding many small queues favours the O(1) meld of a pairing heap
+    SQueue feed(priorityFn1, MAXHEAP, AUTO);
+    if (!feed.isAdaptive() || feed.getStructure() != LEFTIST)
+        return false;
+    for (int i=0;i<3000;i++){
+        SQueue batch(priorityFn1, MAXHEAP, AUTO);
+        for (int j=0;j<4;j++)
+            batch.insertPost(Post(idGen.getRandNum(), likesGen.getRandNum(), conLevelGen.getRandNum(),
+                                  timeGen.getRandNum(), interestGen.getRandNum()));
+        feed.mergeWithQueue(batch);
+    }
+    if (feed.getStructure() != PAIRING || feed.numPosts() != 12000)
+        return false;
+
+    //a steady pop and insert mix moves it back to a leftist heap; the order holds throughout
+    for (int i=0;i<20000;i++){
+        feed.getNextPost();
+        feed.insertPost(Post(idGen.getRandNum(), likesGen.getRandNum(), conLevelGen.getRandNum(),
+                             timeGen.getRandNum(), interestGen.getRandNum()));
+    }
+    const vector<StructureChange>& changes = feed.getStructureChanges();
+    if (feed.getStructure() != LEFTIST || changes.size() != 2 || changes[0].m_to != PAIRING ||
+        changes[1].m_to != LEFTIST || changes[1].m_forced || changes[1].m_newCost >= changes[1].m_cost)
+        return false;
+    if (!testProperty(feed.m_heap, feed.m_priorFunc, feed.m_heapType, feed.m_structure))
+        return false;
+    int last = priorityFn1(feed.getNextPost());
+    while (feed.numPosts() > 0){
+        int priority = priorityFn1(feed.getNextPost());
+        if (priority > last)
+            return false;
+        last = priority;
+    }
+
+    //monotone MINHEAP consumption moves to a radix heap; an insert below the last
+    //popped priority then forces it out again instead of throwing
+    SQueue timeline(priorityFn2, MINHEAP, AUTO);
+    for (int i=0;i<2000;i++)
+        timeline.insertPost(Post(idGen.getRandNum(), likesGen.getRandNum(), conLevelGen.getRandNum(),
+                                 timeGen.getRandNum(), interestGen.getRandNum()));
+    last = 0;
+    for (int i=0;i<5000;i++){
+        last = priorityFn2(timeline.getNextPost());
+        Post post(idGen.getRandNum(), likesGen.getRandNum(), conLevelGen.getRandNum(),
+                  timeGen.getRandNum(), interestGen.getRandNum());
+        while (priorityFn2(post) < last)
+            post = Post(idGen.getRandNum(), likesGen.getRandNum(), conLevelGen.getRandNum(),
+                        timeGen.getRandNum(), interestGen.getRandNum());
+        timeline.insertPost(post);
+    }
+    if (timeline.getStructure() != RADIX)
+        return false;
+    timeline.insertPost(Post(MINPOSTID, MINLIKES, MINCONLEVEL, MINTIME, MININTERESTLEVEL));
+    if (timeline.getStructure() != PAIRING || !timeline.getStructureChanges().back().m_forced ||
+        timeline.numPosts() != 2001 || priorityFn2(timeline.getNextPost()) != MINCONLEVEL + MINTIME)
+        return false;
+
+    //a merge into a radix heap that would break its bound, or between queues of
+    //different functions, throws before either queue is converted
+    SQueue monotone(priorityFn2, MINHEAP, RADIX);
+    monotone.insertPost(Post(MINPOSTID, MINLIKES, MAXCONLEVEL, MAXTIME, MININTERESTLEVEL));
+    monotone.insertPost(Post(MINPOSTID + 1, MINLIKES, MAXCONLEVEL, MAXTIME, MININTERESTLEVEL));
+    monotone.getNextPost();
+    SQueue early(priorityFn2, MINHEAP, AUTO);
+    early.insertPost(Post(MINPOSTID + 2, MINLIKES, MINCONLEVEL, MINTIME, MININTERESTLEVEL));
+    try{
+        monotone.mergeWithQueue(early);
+        return false;
+    }
+    catch (domain_error&){}
+    SQueue otherFn(priorityFn1, MINHEAP, AUTO);
+    otherFn.insertPost(Post(MINPOSTID + 3, MAXLIKES, MAXCONLEVEL, MAXTIME, MININTERESTLEVEL));
+    try{
+        monotone.mergeWithQueue(otherFn);
+        return false;
+    }
+    catch (runtime_error&){}
+    if (early.getStructure() != LEFTIST || early.numPosts() != 1 || otherFn.getStructure() != LEFTIST ||
+        monotone.getStructure() != RADIX || monotone.numPosts() != 1)
+        return false;
+
+    //choosing a structure ends AUTO mode
+    timeline.setStructure(SKEW);
+    return !timeline.isAdaptive() && timeline.getStructure() == SKEW &&
+           testProperty(timeline.m_heap, timeline.m_priorFunc, timeline.m_heapType, timeline.m_structure);
+}
+
+//test that a soft queue returns every post, corrupts at most its error rate and is exact while small
+bool Tester::testSoftQueue(){
+    Random likesGen(MINLIKES,MAXLIKES);
+    Random interestGen(MININTERESTLEVEL,MAXINTERESTLEVEL);
+
+    //with fewer posts than 2^threshold every list holds one post: nothing is corrupted
+    SoftSQueue exact(priorityFn1, MAXHEAP, 0.01);
+    for (int i=0;i<300;i++)
+        exact.insertPost(Post(MINPOSTID + i, likesGen.getRandNum(), MINCONLEVEL, MINTIME, interestGen.getRandNum()));
+    if (exact.numCorrupted() != 0)
+        return false;
+    int last = priorityFn1(exact.getNextPost());
+    while (exact.numPosts() > 0){
+        int priority = priorityFn1(exact.getNextPost());
+        if (priority > last)
+            return false;
+        last = priority;
+    }
+
+    //a large queue built partly by merging stays within its error rate and loses no post
+    SoftSQueue feed(priorityFn1, MAXHEAP, 0.2);
+    SoftSQueue other(priorityFn1, MAXHEAP, 0.2);
+    vector<int> inserted(MAXLIKES + MAXINTERESTLEVEL + 1, 0);
+    for (int i=0;i<20000;i++){
+        Post post(MINPOSTID + i, likesGen.getRandNum(), MINCONLEVEL, MINTIME, interestGen.getRandNum());
+        (i % 2 ? feed : other).insertPost(post);
+        inserted[priorityFn1(post)]++;
+    }
+    feed.mergeWithQueue(other);
+    if (feed.numPosts() != 20000 || other.numPosts() != 0)
+        return false;
+    bool bounded = true;
+    while (feed.numPosts() > 0){
+        if (feed.numPosts() % 1000 == 0)
+            bounded = bounded && feed.numCorrupted() <= 0.2 * 20000;
+        inserted[priorityFn1(feed.getNextPost())]--;
+    }
+    for (size_t i = 0; i < inserted.size(); i++)
+        if (inserted[i] != 0)
+            return false;
+
+    //the usual errors of an empty queue and of invalid parameters
+    try{
+        feed.getNextPost();
+        return false;
+    }
+    catch (out_of_range&){}
+    try{
+        SoftSQueue invalid(priorityFn1, MAXHEAP, 0.75);
+        return false;
+    }
+    catch (out_of_range&){}
+    return bounded;
+}
+
+bool Tester::testTraceReplay(){
+    //a Zipf and bursty workload with merges and reprioritizations
+    WorkloadConfig config;
+    config.m_likes = ZIPFDIST;
+    config.m_time = BURSTYDIST;
+    config.m_burstLength = 100;
+    config.m_inserts = 6;
+    config.m_pops = 4;
+    config.m_merges = 1;
+    config.m_reprioritizations = 1;
+    config.m_baseFn = priorityFn1;
+    config.m_baseHeapType = MAXHEAP;
+    config.m_altFn = priorityFn2;
+
+    //the same seed gives the same posts, and most posts have few likes
+    WorkloadGen gen1(config), gen2(config);
+    int fewLikes = 0;
+    for (int i=0;i<10000;i++){
+        Post post = gen1.getPost();
+        if (post.getPayload() != gen2.getPost().getPayload())
+            return false;
+        if (post.getNumLikes() < (MINLIKES + MAXLIKES) / 10)
+            fewLikes++;
+    }
+    if (fewLikes < 5000)
+        return false;
+
+    //a reprioritization to another function with the same heap type rekeys the queue
+    WorkloadConfig rekeyOnly;
+    rekeyOnly.m_inserts = 0;
+    rekeyOnly.m_pops = 0;
+    rekeyOnly.m_reprioritizations = 1;
+    rekeyOnly.m_baseFn = priorityFn1;
+    rekeyOnly.m_baseHeapType = MAXHEAP;
+    rekeyOnly.m_altFn = priorityById;
+    rekeyOnly.m_altHeapType = MAXHEAP;
+    SQueue rekeyed(priorityFn1, MAXHEAP, LEFTIST);
+    for (int i=0;i<1000;i++)
+        rekeyed.insertPost(gen1.getPost());
+    WorkloadGen rekeyGen(rekeyOnly);
+    rekeyGen.run(rekeyed, 1);
+    if (rekeyed.getPriorityFn() != priorityById ||
+        !testProperty(rekeyed.m_heap, priorityById, MAXHEAP, LEFTIST))
+        return false;
+    //a queue that starts on the second function switches to the base one
+    SQueue startsOnAlt(priorityById, MAXHEAP, LEFTIST);
+    for (int i=0;i<100;i++)
+        startsOnAlt.insertPost(gen1.getPost());
+    WorkloadGen(rekeyOnly).run(startsOnAlt, 1);
+    if (startsOnAlt.getPriorityFn() != priorityFn1 ||
+        !testProperty(startsOnAlt.m_heap, priorityFn1, MAXHEAP, LEFTIST))
+        return false;
+
+    //replaying the recorded calls pops the same posts
+    string path = "/tmp/squeue_trace_" + to_string(getpid());
+    uint64_t recorded;
+    vector<prifn_t> functions;
+    {
+        TraceRecorder recorder(path);
+        try{
+            TraceRecorder second(path + "_2");
+            return false;
+        }
+        catch (runtime_error&){}
+        SQueue queue(priorityFn1, MAXHEAP, LEFTIST);
+        WorkloadGen gen(config);
+        recorded = gen.run(queue, 20000);
+        SQueue copy(queue);
+        copy.setStructure(SKEW);
+        while (copy.numPosts() > 0)
+            recorded = recorded * 31 + copy.getNextPost().getPostID();
+        functions = recorder.getFunctions();
+    }
+    TraceReplayer replayer(path, functions);
+    uint64_t replayed = replayer.replay();
+    bool same = replayed == recorded && replayer.replay() == recorded && replayer.numFailures() == 0;
+    remove(path.c_str());
+    remove((path + "_2").c_str());
+    if (!same || replayer.numQueues() < 3)
+        return false;
+
+    //queues with linear models (negative weights included), lazy merges, threads
+    //and deferred clears are recorded and replayed as well
+    {
+        TraceRecorder recorder(path);
+        LinearPriority model(1, -20, 0, 1, 100, 1, 700);
+        SQueue linear(model, MAXHEAP, PAIRING);
+        SQueue other(model, MAXHEAP, PAIRING);
+        linear.setLazyMerge(true);
+        linear.setThreads(2);
+        other.setDeferredClear(true);
+        WorkloadGen gen(config);
+        for (int i=0;i<2000;i++){
+            linear.insertPost(gen.getPost());
+            other.insertPost(gen.getPost());
+        }
+        linear.mergeWithQueue(other);
+        recorded = 0;
+        for (int i=0;i<1000;i++)
+            recorded = recorded * 31 + linear.getNextPost().getPostID();
+        linear.setPriorityModel(LinearPriority(0, 1, 1, 0, 0, 2, 55), MINHEAP);
+        while (linear.numPosts() > 0)
+            recorded = recorded * 31 + linear.getNextPost().getPostID();
+        functions = recorder.getFunctions();
+    }
+    SQueue::waitForReclaim();
+    TraceReplayer linearReplayer(path, functions);
+    if (linearReplayer.replay() != recorded || linearReplayer.numFailures() != 0)
+        return false;
+
+    //a merge that a radix heap rejects is not in the trace, so it does not fail
+    //or change anything when the trace is replayed
+    {
+        TraceRecorder recorder(path);
+        SQueue bounded(priorityFn2, MINHEAP, RADIX), below(priorityFn2, MINHEAP, RADIX);
+        bounded.insertPost(Post(MINPOSTID, MINLIKES, MAXCONLEVEL, MAXTIME, MININTERESTLEVEL));
+        bounded.insertPost(Post(MINPOSTID + 1, MINLIKES, MAXCONLEVEL, MAXTIME, MININTERESTLEVEL));
+        recorded = bounded.getNextPost().getPostID();
+        below.insertPost(Post(MINPOSTID + 2, MINLIKES, MINCONLEVEL, MINTIME, MININTERESTLEVEL));
+        try{
+            bounded.mergeWithQueue(below);
+            return false;
+        }
+        catch (domain_error &e){}
+        try{
+            bounded.mergeWithQueue(below, true);
+            return false;
+        }
+        catch (domain_error &e){}
+        recorded = recorded * 31 + below.getNextPost().getPostID();
+        recorded = recorded * 31 + bounded.getNextPost().getPostID();
+        functions = recorder.getFunctions();
+    }
+    TraceReplayer rejectedReplayer(path, functions);
+    if (rejectedReplayer.replay() != recorded || rejectedReplayer.numFailures() != 0)
+        return false;
+
+    //recorders stopped while other threads keep using their queues wait for the
+    //calls in flight instead of being freed under them
+    atomic<bool> stop(false);
+    vector<thread> users;
+    for (int t=0;t<2;t++){
+        users.push_back(thread([&stop]{
+            SQueue queue(priorityFn1, MAXHEAP, LEFTIST);
+            for (int i=0; !stop.load(); i++){
+                queue.insertPost(Post(MINPOSTID + i % 1000, i % MAXLIKES, MINCONLEVEL, MINTIME, MININTERESTLEVEL));
+                if (i % 2 == 1)
+                    queue.getNextPost();
+            }
+        }));
+    }
+    for (int i=0;i<50;i++)
+        TraceRecorder recorder(path);
+    stop = true;
+    for (int t=0;t<2;t++)
+        users[t].join();
+    remove(path.c_str());
+    return !TraceRecorder::Call();
+}
+
+bool Tester::testExternalQueue(){
+    Random likesGen(MINLIKES,MAXLIKES);
+    Random interestGen(MININTERESTLEVEL,MAXINTERESTLEVEL);
+
+    //a front of 100 posts spills 200 runs, merged into runs of level 1; every pop
+    //matches an in-memory queue given the same inserts
+    ExternalSQueue external(priorityFn1, MAXHEAP, "/tmp", 100);
+    SQueue reference(priorityFn1, MAXHEAP, LEFTIST);
+    int id = MINPOSTID;
+    for (int round=0;round<4;round++){
+        for (int i=0;i<5000;i++){
+            Post post(id++, likesGen.getRandNum(), MINCONLEVEL, MINTIME, interestGen.getRandNum());
+            external.insertPost(post);
+            reference.insertPost(post);
+        }
+        for (int i=0;i<3000;i++)
+            if (priorityFn1(external.getNextPost()) != priorityFn1(reference.getNextPost()))
+                return false;
+    }
+    if (external.numPosts() != 8000 || external.getBytesWritten() < 20000 * (long long)sizeof(uint64_t))
+        return false;
+    bool merged = false;
+    for (size_t i = 0; i < external.m_runs.size(); i++)
+        merged = merged || external.m_runs[i]->m_level > 0;
+    while (reference.numPosts() > 0)
+        if (priorityFn1(external.getNextPost()) != priorityFn1(reference.getNextPost()))
+            return false;
+    if (external.numPosts() != 0 || external.numRuns() != 0 || !merged)
+        return false;
+
+    //a cleared queue keeps its priority function and heap type
+    for (int i=0;i<250;i++)
+        external.insertPost(Post(MINPOSTID + i, likesGen.getRandNum(), MINCONLEVEL, MINTIME, interestGen.getRandNum()));
+    external.clear();
+    if (external.numPosts() != 0 || external.numRuns() != 0)
+        return false;
+    external.insertPost(Post(MINPOSTID, 10, MINCONLEVEL, MINTIME, MININTERESTLEVEL));
+    external.insertPost(Post(MINPOSTID + 1, 20, MINCONLEVEL, MINTIME, MININTERESTLEVEL));
+    if (external.getNextPost().getNumLikes() != 20 || external.getNextPost().getNumLikes() != 10)
+        return false;
+
+    //a run block that cannot be read fails the pop without losing its post; once the
+    //run can be read again the pops carry on in order
+    const int RUNBLOCK = 1 << 16; //posts per block of a run, as in externalsqueue.cpp
+    ExternalSQueue single(priorityFn1, MAXHEAP, "/tmp", RUNBLOCK + 1000);
+    SQueue singleReference(priorityFn1, MAXHEAP, LEFTIST);
+    for (int i=0;i<RUNBLOCK + 1000;i++){
+        Post post(MINPOSTID + i % 1000, likesGen.getRandNum(), MINCONLEVEL, MINTIME, interestGen.getRandNum());
+        single.insertPost(post);
+        singleReference.insertPost(post);
+    }
+    if (single.numRuns() != 1)
+        return false;
+    for (int i=0;i<RUNBLOCK - 1;i++)
+        if (priorityFn1(single.getNextPost()) != priorityFn1(singleReference.getNextPost()))
+            return false;
+    int runFd = single.m_runs[0]->m_fd;
+    int saved = dup(runFd);
+    close(runFd);
+    try{
+        single.getNextPost();
+        return false;
+    }
+    catch (runtime_error&){}
+    dup2(saved, runFd);
+    close(saved);
+    if (single.numPosts() != 1001)
+        return false;
+    while (singleReference.numPosts() > 0)
+        if (priorityFn1(single.getNextPost()) != priorityFn1(singleReference.getNextPost()))
+            return false;
+    if (single.numPosts() != 0)
+        return false;
+
+    //the usual errors of an empty queue and of invalid parameters
+    try{
+        external.getNextPost();
+        return false;
+    }
+    catch (out_of_range&){}
+    try{
+        ExternalSQueue invalid(priorityFn1, MAXHEAP, "/tmp", 0);
+        return false;
+    }
+    catch (out_of_range&){}
+    try{
+        ExternalSQueue missing(priorityFn1, MAXHEAP, "/nonexistent_squeue_dir", 1);
+        missing.insertPost(Post(MINPOSTID, MINLIKES, MINCONLEVEL, MINTIME, MININTERESTLEVEL));
+        return false;
+    }
+    catch (runtime_error&){}
+    return true;
+}
+
+//test merging queues of other structures, heap types and priority functions
+bool Tester::testConvertingMerge(){
+    Random idGen(MINPOSTID,MAXPOSTID);
+    Random likesGen(MINLIKES,MAXLIKES);
+    Random timeGen(MINTIME,MAXTIME);
+    Random conLevelGen(MINCONLEVEL,MAXCONLEVEL);
+    Random interestGen(MININTERESTLEVEL,MAXINTERESTLEVEL);
+    SQueue target(priorityFn1, MAXHEAP, LEFTIST);
+    SQueue reference(priorityFn1, MAXHEAP, LEFTIST);
+    SQueue pairing(priorityFn2, MINHEAP, PAIRING);
+    SQueue lazySkew(priorityFn2, MINHEAP, SKEW);
+    SQueue radix(priorityFn2, MINHEAP, RADIX);
+    lazySkew.setLazyMerge(true);
+    for (int i=0;i<600;i++){
+        Post myPost(idGen.getRandNum(),
+                    likesGen.getRandNum(),
+                    conLevelGen.getRandNum(),
+                    timeGen.getRandNum(),
+                    interestGen.getRandNum());
+        if (i < 200)
+            target.insertPost(myPost);
+        else if (i < 400)
+            pairing.insertPost(myPost);
+        else if (i < 500){
+            SQueue part(priorityFn2, MINHEAP, SKEW);
+            part.insertPost(myPost);
+            lazySkew.mergeWithQueue(part);
+        }
+        else
+            radix.insertPost(myPost);
+        reference.insertPost(myPost);
+    }
+
+    //a plain merge still requires the same properties
+    try{
+        target.mergeWithQueue(pairing);
+        return false;
+    }
+    catch (runtime_error&){}
+
+    //a radix heap rejects priorities below its bound and leaves the RHS intact
+    SQueue monotone(priorityFn2, MINHEAP, RADIX);
+    monotone.insertPost(Post(MINPOSTID, MINLIKES, MINCONLEVEL, MAXTIME, MININTERESTLEVEL));
+    monotone.getNextPost();
+    try{
+        monotone.mergeWithQueue(pairing, true);
+        return false;
+    }
+    catch (domain_error&){}
+    if (pairing.numPosts() != 200 || monotone.numPosts() != 0)
+        return false;
+
+    target.mergeWithQueue(pairing, true);
+    target.mergeWithQueue(lazySkew, true);
+    target.mergeWithQueue(radix, true);
+    if (target.numPosts() != 600 || pairing.numPosts() != 0 || lazySkew.numPosts() != 0 || radix.numPosts() != 0)
+        return false;
+    if (pairing.getHeapType() != MINHEAP || pairing.getStructure() != PAIRING)
+        return false;
+    if (!testProperty(target.m_heap, target.m_priorFunc, target.m_heapType, target.m_structure))
+        return false;
+    while (reference.numPosts() > 0)
+        if (priorityFn1(target.getNextPost()) != priorityFn1(reference.getNextPost()))
+            return false;
+
+    //the emptied queues keep working with their own configuration
+    pairing.insertPost(Post(MINPOSTID, MINLIKES, MINCONLEVEL, MINTIME, MININTERESTLEVEL));
+    if (pairing.numPosts() != 1 || target.numPosts() != 0)
+        return false;
+
+    //decaying queues that only differ in their epoch are re-keyed on this queue's clock
+    SQueue current(priorityFn1, MAXHEAP, LEFTIST), ahead(priorityFn1, MAXHEAP, LEFTIST);
+    current.setDecay(4);
+    ahead.setDecay(4);
+    current.insertPost(Post(MINPOSTID, 396, MINCONLEVEL, MINTIME, 4));          //priority 400 at epoch 0
+    ahead.advanceEpoch(100);
+    ahead.insertPost(Post(MINPOSTID + 1, 96, MINCONLEVEL, MINTIME, 4));         //priority 100 at epoch 100
+    current.mergeWithQueue(ahead, true);
+    if (current.peekNextPost().getPostID() != MINPOSTID || current.decayedPriority(current.peekNextPost()) != 400)
+        return false;
+    current.getNextPost();
+    return current.decayedPriority(current.getNextPost()) == 100 && ahead.numPosts() == 0;
+}
 
 int main(){
     Tester tester;
@@ -386,8 +1685,50 @@ int main(){
     cout<<"Test of 300 insertions in a LEFTIST Maxheap: "<<(tester.testMaxHeapInsertion()? "Passed":"Failed")<<endl;
     cout<<"Test whether the Leftist Maxheap conserves its properties after removals: "<<(tester.testMaxHeapRemoval()? "Passed":"Failed")<<endl;
     cout<<"Test of merging a normal and empty queue: "<<(tester.testMergeWithQueueEdgeCase()?"Passed":"Failed")<<endl;
+    cout<<"Test of lazy merging with deferred consolidation: "<<(tester.testLazyMerge()?"Passed":"Failed")<<endl;
+    cout<<"Test of the pairing heap structure: "<<(tester.testPairingHeap()?"Passed":"Failed")<<endl;
+    cout<<"Test of the monotone radix heap structure: "<<(tester.testRadixHeap()?"Passed":"Failed")<<endl;
+    cout<<"Test of time-decayed priorities across epochs: "<<(tester.testTimeDecay()?"Passed":"Failed")<<endl;
+    cout<<"Test of bulk insertion with a linear priority model: "<<(tester.testLinearPriority()?"Passed":"Failed")<<endl;
+    cout<<"Test of multithreaded copy, rebuild and teardown: "<<(tester.testParallelTreeOperations()?"Passed":"Failed")<<endl;
+    cout<<"Test of ordered non-destructive iteration: "<<(tester.testOrderedIteration()?"Passed":"Failed")<<endl;
+    cout<<"Test of per-user queues with inline storage: "<<(tester.testQueueManager()?"Passed":"Failed")<<endl;
+    cout<<"Test of the partitioned queue: "<<(tester.testPartitionedQueue()?"Passed":"Failed")<<endl;
+    cout<<"Test of the coroutine queue: "<<(tester.testAsyncQueue()?"Passed":"Failed")<<endl;
+    cout<<"Test of buffered text, JSON and binary export: "<<(tester.testExport()?"Passed":"Failed")<<endl;
+    cout<<"Test of iterative and deferred teardown: "<<(tester.testTeardown()?"Passed":"Failed")<<endl;
+    cout<<"Test of the packed post fields: "<<(tester.testPackedPost()?"Passed":"Failed")<<endl;
+    cout<<"Test of the capacity-bounded queue: "<<(tester.testBoundedQueue()?"Passed":"Failed")<<endl;
+    cout<<"Test of the shared-memory queue: "<<(tester.testSharedQueue()?"Passed":"Failed")<<endl;
+    cout<<"Test of AUTO structure selection: "<<(tester.testAdaptiveStructure()?"Passed":"Failed")<<endl;
+    cout<<"Test of the approximate soft-heap queue: "<<(tester.testSoftQueue()?"Passed":"Failed")<<endl;
+    cout<<"Test of the workload generator and trace replay: "<<(tester.testTraceReplay()?"Passed":"Failed")<<endl;
+    cout<<"Test of the external-memory queue: "<<(tester.testExternalQueue()?"Passed":"Failed")<<endl;
+    cout<<"Test of merging differently configured queues: "<<(tester.testConvertingMerge()?"Passed":"Failed")<<endl;
 
     
     
     return 0;
 }
+AsyncTask consumePosts(AsyncQueue &queue, vector<int> &likes, bool &done){
+    while (optional<Post> post = co_await queue.next())
+        likes.push_back(post->getNumLikes());
+    done = true;
+}
+AsyncTask consumeBatches(AsyncQueue &queue, int k, vector<int> &sizes, bool &done){
+    while (true){
+        vector<Post> batch = co_await queue.nextBatch(k);
+        if (batch.empty())
+            break;
+        sizes.push_back((int)batch.size());
+    }
+    done = true;
+}
+AsyncTask producePosts(AsyncQueue &queue, int count, int &pushed, bool &done){
+    for (int i = 0; i < count; i++){
+        if (!co_await queue.push(Post(MINPOSTID + i, 10 + i, MINCONLEVEL, MINTIME, MININTERESTLEVEL)))
+            break;
+        pushed++;
+    }
+    done = true;
+}
@@ -0,0 +1,189 @@
+
+#include "queuemanager.h"
+
+// QueueManager constructor: every tenant queue shares the priority function, heap type and structure
+QueueManager::QueueManager(prifn_t priFn, HEAPTYPE heapType, STRUCTURE structure, int inlineCapacity) {
+    if (inlineCapacity < 1 || inlineCapacity > 1024)
+        throw out_of_range("Invalid inline capacity");
+    m_priorFunc = priFn;
+    m_heapType = heapType;
+    m_structure = structure;
+    m_inlineCapacity = inlineCapacity;
+
+    // One size class per power of two below the inline capacity, plus the capacity itself
+    int classes = 1;
+    while (classCapacity(classes - 1) < inlineCapacity)
+        classes++;
+    m_arenas.resize(classes);
+    m_freeBlocks.resize(classes);
+}
+
+// QueueManager destructor: deletes the promoted queues; the arena frees itself
+QueueManager::~QueueManager() {
+    for (unordered_map<int, Tenant>::iterator it = m_tenants.begin(); it != m_tenants.end(); it++)
+        delete it->second.m_queue;
+}
+
+// Inserts a post into a user's queue, creating the queue on first use
+bool QueueManager::insertPost(int user, const Post& post) {
+    int priority = m_priorFunc(post);
+    if (priority == 0) // Invalid priority, as for SQueue::insertPost
+        return false;
+
+    unordered_map<int, Tenant>::iterator it = m_tenants.find(user);
+    if (it == m_tenants.end()){
+        Tenant tenant;
+        tenant.m_block = -1;
+        tenant.m_count = 0;
+        tenant.m_class = 0;
+        tenant.m_queue = nullptr;
+        it = m_tenants.insert(make_pair(user, tenant)).first;
+    }
+    Tenant& tenant = it->second;
+
+    if (tenant.m_queue == nullptr && tenant.m_count == m_inlineCapacity)
+        promote(tenant); // The inline block is full
+    if (tenant.m_queue != nullptr)
+        return tenant.m_queue->insertPost(post);
+
+    if (tenant.m_block < 0){
+        tenant.m_class = 0;
+        tenant.m_block = allocateBlock(0);
+    }
+    else if (tenant.m_count == classCapacity(tenant.m_class))
+        growBlock(tenant);
+
+    // Keep the block sorted with the best post at the end: shift every post that
+    // ranks ahead of the new one up by one slot
+    InlinePost* block = &m_arenas[tenant.m_class][tenant.m_block];
+    int pos = tenant.m_count;
+    while (pos > 0 && (m_heapType == MAXHEAP ? block[pos - 1].m_key > priority : block[pos - 1].m_key < priority)){
+        block[pos] = block[pos - 1];
+        pos--;
+    }
+    block[pos].m_key = priority;
+    block[pos].m_payload = post.getPayload();
+    tenant.m_count++;
+    return true;
+}
+
+// Retrieves and removes the highest priority post of a user
+Post QueueManager::getNextPost(int user) {
+    unordered_map<int, Tenant>::iterator it = m_tenants.find(user);
+    if (it == m_tenants.end())
+        throw out_of_range("Empty Queue");
+    Tenant& tenant = it->second;
+
+    if (tenant.m_queue != nullptr){
+        Post post = tenant.m_queue->getNextPost();
+        if (tenant.m_queue->numPosts() == 0){ // A drained queue goes back to inline storage
+            delete tenant.m_queue;
+            tenant.m_queue = nullptr;
+        }
+        return post;
+    }
+
+    if (tenant.m_count == 0)
+        throw out_of_range("Empty Queue");
+    tenant.m_count--;
+    Post post = toPost(m_arenas[tenant.m_class][tenant.m_block + tenant.m_count]);
+    if (tenant.m_count == 0)
+        releaseBlock(tenant);
+    return post;
+}
+
+// Returns the number of posts of a user (0 for an unknown user)
+int QueueManager::numPosts(int user) const {
+    unordered_map<int, Tenant>::const_iterator it = m_tenants.find(user);
+    if (it == m_tenants.end())
+        return 0;
+    if (it->second.m_queue != nullptr)
+        return it->second.m_queue->numPosts();
+    return it->second.m_count;
+}
+
+// Returns the number of users with a queue
+int QueueManager::numQueues() const {
+    return (int)m_tenants.size();
+}
+
+// Returns whether a user's posts were promoted to an SQueue
+bool QueueManager::isPromoted(int user) const {
+    unordered_map<int, Tenant>::const_iterator it = m_tenants.find(user);
+    return it != m_tenants.end() && it->second.m_queue != nullptr;
+}
+
+// Drops a user's queue with all of its posts
+void QueueManager::removeQueue(int user) {
+    unordered_map<int, Tenant>::iterator it = m_tenants.find(user);
+    if (it == m_tenants.end())
+        return;
+    delete it->second.m_queue;
+    releaseBlock(it->second);
+    m_tenants.erase(it);
+}
+
+// Approximate bytes held by all queues: the arenas, the tenant table (one node
+// and one bucket pointer per entry) and the promoted queues with their nodes
+size_t QueueManager::memoryUsage() const {
+    size_t bytes = 0;
+    for (size_t i = 0; i < m_arenas.size(); i++)
+        bytes += m_arenas[i].capacity() * sizeof(InlinePost) + m_freeBlocks[i].capacity() * sizeof(int);
+    bytes += m_tenants.size() * (sizeof(pair<const int, Tenant>) + 2 * sizeof(void*));
+    bytes += m_tenants.bucket_count() * sizeof(void*);
+    for (unordered_map<int, Tenant>::const_iterator it = m_tenants.begin(); it != m_tenants.end(); it++)
+        if (it->second.m_queue != nullptr)
+            bytes += sizeof(SQueue) + it->second.m_queue->numPosts() * sizeof(Post);
+    return bytes;
+}
+
+// Returns the number of posts a block of a size class holds
+int QueueManager::classCapacity(int sizeClass) const {
+    return min(1 << sizeClass, m_inlineCapacity);
+}
+
+// Returns the first slot of a free block of a size class, growing its arena if needed
+int QueueManager::allocateBlock(int sizeClass) {
+    if (!m_freeBlocks[sizeClass].empty()){
+        int block = m_freeBlocks[sizeClass].back();
+        m_freeBlocks[sizeClass].pop_back();
+        return block;
+    }
+    int block = (int)m_arenas[sizeClass].size();
+    m_arenas[sizeClass].resize(m_arenas[sizeClass].size() + classCapacity(sizeClass));
+    return block;
+}
+
+// Moves a tenant's full inline block into a block of the next size class
+void QueueManager::growBlock(Tenant& tenant) {
+    int block = allocateBlock(tenant.m_class + 1);
+    for (int i = 0; i < tenant.m_count; i++)
+        m_arenas[tenant.m_class + 1][block + i] = m_arenas[tenant.m_class][tenant.m_block + i];
+    m_freeBlocks[tenant.m_class].push_back(tenant.m_block);
+    tenant.m_block = block;
+    tenant.m_class++;
+}
+
+// Returns a tenant's arena block to the free list of its size class
+void QueueManager::releaseBlock(Tenant& tenant) {
+    if (tenant.m_block >= 0)
+        m_freeBlocks[tenant.m_class].push_back(tenant.m_block);
+    tenant.m_block = -1;
+    tenant.m_count = 0;
+    tenant.m_class = 0;
+}
+
+// Moves a tenant's inline posts into a new SQueue in one bulk insert
+void QueueManager::promote(Tenant& tenant) {
+    vector<Post> posts;
+    for (int i = 0; i < tenant.m_count; i++)
+        posts.push_back(toPost(m_arenas[tenant.m_class][tenant.m_block + i]));
+    tenant.m_queue = new SQueue(m_priorFunc, m_heapType, m_structure);
+    tenant.m_queue->insertPosts(posts.data(), (int)posts.size());
+    releaseBlock(tenant);
+}
+
+// Rebuilds a Post from its inline form
+Post QueueManager::toPost(const InlinePost& entry) const {
+    return Post(entry.m_payload);
+}
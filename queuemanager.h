@@ -0,0 +1,59 @@
+#ifndef QUEUEMANAGER_H
+#define QUEUEMANAGER_H
+#include "squeue.h"
+#include <unordered_map>
+#include <vector>
+using namespace std;
+class Tester;   // forward declaration (for testing purposes)
+
+// Owns one post queue per user (tenant). A tenant with few posts keeps them in a
+// block of a shared arena as a small array sorted by priority. Blocks come in
+// power-of-two size classes up to the inline capacity, so a tenant with one post
+// uses one slot; only when it grows past the inline capacity is it promoted to a
+// real SQueue. A promoted queue that is drained goes back to inline storage
+class QueueManager{
+    public:
+    friend class Tester; // for testing purposes
+
+    QueueManager(prifn_t priFn, HEAPTYPE heapType, STRUCTURE structure, int inlineCapacity = 16);
+    ~QueueManager();
+    QueueManager(const QueueManager& rhs) = delete; // queues are owned, not shared
+    QueueManager& operator=(const QueueManager& rhs) = delete;
+    bool insertPost(int user, const Post& post);
+    Post getNextPost(int user); // Returns the highest priority post of a user
+    int numPosts(int user) const;
+    int numQueues() const; // Number of users with a queue
+    bool isPromoted(int user) const; // Whether a user's posts live in an SQueue
+    void removeQueue(int user); // Drops a user's queue and all of its posts
+    size_t memoryUsage() const; // Approximate bytes held by all queues
+
+    private:
+    // A post stored inline: its packed fields and its priority, without any heap links
+    struct InlinePost{
+        uint64_t m_payload;
+        int m_key;
+    };
+    // Per-user state: an arena block (or -1) while inline, an SQueue once promoted
+    struct Tenant{
+        int m_block;        // first arena slot of the inline block
+        short m_count;      // posts stored inline
+        short m_class;      // size class of the inline block
+        SQueue* m_queue;    // promoted queue, nullptr while inline
+    };
+
+    prifn_t m_priorFunc;    // priority function of every queue
+    HEAPTYPE m_heapType;    // heap type of every queue
+    STRUCTURE m_structure;  // structure of the promoted queues
+    int m_inlineCapacity;   // posts a tenant keeps inline before it is promoted
+    vector< vector<InlinePost> > m_arenas;  // inline blocks of all tenants, one arena per size class
+    vector< vector<int> > m_freeBlocks;     // released blocks per size class
+    unordered_map<int, Tenant> m_tenants;
+
+    int classCapacity(int sizeClass) const;
+    int allocateBlock(int sizeClass);
+    void growBlock(Tenant& tenant);
+    void releaseBlock(Tenant& tenant);
+    void promote(Tenant& tenant);
+    Post toPost(const InlinePost& entry) const;
+};
+#endif
@@ -0,0 +1,221 @@
+
+#include "sharedsqueue.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+const unsigned SHAREDMAGIC = 0x53515545; // "SQUE", marks an initialized segment
+
+// Creates and initializes a segment for capacity posts
+SharedSQueue::SharedSQueue(const string& name, prifn_t priFn, HEAPTYPE heapType, int capacity) {
+    if (capacity < 1)
+        throw out_of_range("Invalid capacity");
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+        throw runtime_error("shm_open failed: " + string(strerror(errno)));
+    size_t length = segmentLength(capacity);
+    if (ftruncate(fd, length) != 0){
+        int error = errno;
+        close(fd);
+        shm_unlink(name.c_str());
+        throw runtime_error("ftruncate failed: " + string(strerror(error)));
+    }
+    try{
+        map(fd, length); // closes fd whether it succeeds or not
+    }
+    catch (...){
+        shm_unlink(name.c_str()); // the next creator must not find a half made segment
+        throw;
+    }
+    m_priorFunc = priFn;
+
+    m_control->m_capacity = capacity;
+    m_control->m_heapType = heapType;
+    m_control->m_root = NONE;
+    m_control->m_size = 0;
+    m_control->m_free = NONE;
+    m_control->m_fresh = 0;
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST); // a crashed holder does not block everyone
+    pthread_mutex_init(&m_control->m_lock, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+    __atomic_store_n(&m_control->m_magic, SHAREDMAGIC, __ATOMIC_RELEASE);
+}
+
+// Opens an initialized segment
+SharedSQueue::SharedSQueue(const string& name, prifn_t priFn) {
+    int fd = shm_open(name.c_str(), O_RDWR, 0600);
+    if (fd < 0)
+        throw runtime_error("shm_open failed: " + string(strerror(errno)));
+    struct stat status;
+    if (fstat(fd, &status) != 0 || status.st_size < (off_t)sizeof(Control)){
+        close(fd);
+        throw runtime_error("Shared queue is not initialized");
+    }
+    map(fd, status.st_size);
+    m_priorFunc = priFn;
+    if (__atomic_load_n(&m_control->m_magic, __ATOMIC_ACQUIRE) != SHAREDMAGIC ||
+        segmentLength(m_control->m_capacity) != m_length){
+        munmap(m_control, m_length);
+        throw runtime_error("Shared queue is not initialized");
+    }
+}
+
+// Unmaps the segment; the posts stay for the other processes
+SharedSQueue::~SharedSQueue() {
+    munmap(m_control, m_length);
+}
+
+// Inserts a post computed with this process's priority function
+bool SharedSQueue::insertPost(const Post& post) {
+    lock();
+    bool inserted = insertLocked(post);
+    unlock();
+    return inserted;
+}
+
+// Inserts posts until one does not fit; invalid posts are skipped
+int SharedSQueue::insertPosts(const Post posts[], int count) {
+    int inserted = 0;
+    lock();
+    for (int i = 0; i < count && m_control->m_size < m_control->m_capacity; i++)
+        if (insertLocked(posts[i]))
+            inserted++;
+    unlock();
+    return inserted;
+}
+
+// Retrieves and removes the highest priority post
+Post SharedSQueue::getNextPost() {
+    lock();
+    if (m_control->m_root == NONE){
+        unlock();
+        throw out_of_range("Empty Queue");
+    }
+    Post post = popLocked();
+    unlock();
+    return post;
+}
+
+// Retrieves and removes up to count posts in priority order
+int SharedSQueue::getNextPosts(Post posts[], int count) {
+    int taken = 0;
+    lock();
+    while (taken < count && m_control->m_root != NONE)
+        posts[taken++] = popLocked();
+    unlock();
+    return taken;
+}
+
+int SharedSQueue::numPosts() const {
+    lock();
+    int size = m_control->m_size;
+    unlock();
+    return size;
+}
+
+int SharedSQueue::getCapacity() const {
+    return m_control->m_capacity;
+}
+
+HEAPTYPE SharedSQueue::getHeapType() const {
+    return (HEAPTYPE)m_control->m_heapType;
+}
+
+// Removes the segment name, so that it can be created again
+void SharedSQueue::unlink(const string& name) {
+    shm_unlink(name.c_str());
+}
+
+// Maps the segment and closes its descriptor
+void SharedSQueue::map(int fd, size_t length) {
+    void* address = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int error = errno;
+    close(fd);
+    if (address == MAP_FAILED)
+        throw runtime_error("mmap failed: " + string(strerror(error)));
+    m_control = (Control*)address;
+    m_nodes = (Node*)((char*)address + segmentLength(0));
+    m_length = length;
+}
+
+// Takes the segment lock. If its holder died, the lock is made usable again;
+// the heap is consistent unless the holder died in the middle of an update
+void SharedSQueue::lock() const {
+    if (pthread_mutex_lock(&m_control->m_lock) == EOWNERDEAD)
+        pthread_mutex_consistent(&m_control->m_lock);
+}
+
+void SharedSQueue::unlock() const {
+    pthread_mutex_unlock(&m_control->m_lock);
+}
+
+// Takes a node off the free list (or a fresh one) and merges it in; called with the lock held
+bool SharedSQueue::insertLocked(const Post& post) {
+    int priority = m_priorFunc(post);
+    if (priority == 0 || m_control->m_size >= m_control->m_capacity)
+        return false;
+    int index = m_control->m_free;
+    if (index != NONE)
+        m_control->m_free = m_nodes[index].m_right;
+    else
+        index = m_control->m_fresh++;
+    Node& node = m_nodes[index];
+    node.m_payload = post.getPayload();
+    node.m_rank = (m_control->m_heapType == MAXHEAP) ? priority : -priority;
+    node.m_left = NONE;
+    node.m_right = NONE;
+    node.m_npl = 0;
+    m_control->m_root = merge(m_control->m_root, index);
+    m_control->m_size++;
+    return true;
+}
+
+// Removes the root and returns its node to the free list; called with the lock held
+Post SharedSQueue::popLocked() {
+    int root = m_control->m_root;
+    Post post(m_nodes[root].m_payload);
+    m_control->m_root = merge(m_nodes[root].m_left, m_nodes[root].m_right);
+    m_nodes[root].m_right = m_control->m_free;
+    m_control->m_free = root;
+    m_control->m_size--;
+    return post;
+}
+
+// Merges two leftist heaps given by the index of their roots, as SQueue::mergeLeftist does
+int SharedSQueue::merge(int root, int node) {
+    // Handle empty heaps
+    if (root == NONE) return node;
+    if (node == NONE) return root;
+
+    // The better rank becomes the root
+    if (m_nodes[root].m_rank < m_nodes[node].m_rank)
+        swap(root, node);
+
+    // Merge on the right subtree
+    Node& top = m_nodes[root];
+    top.m_right = merge(top.m_right, node);
+
+    // Keep the left child's NPL at least the right child's and update the NPL
+    if (top.m_left == NONE){
+        top.m_left = top.m_right;
+        top.m_right = NONE;
+        top.m_npl = 0;
+    }
+    else{
+        if (m_nodes[top.m_left].m_npl < m_nodes[top.m_right].m_npl)
+            swap(top.m_left, top.m_right);
+        top.m_npl = m_nodes[top.m_right].m_npl + 1;
+    }
+    return root;
+}
+
+// Bytes of a segment: the control block rounded up to a cache line, then the nodes
+size_t SharedSQueue::segmentLength(int capacity) {
+    return (sizeof(Control) + 63) / 64 * 64 + (size_t)capacity * sizeof(Node);
+}
@@ -0,0 +1,72 @@
+#ifndef SHAREDSQUEUE_H
+#define SHAREDSQUEUE_H
+#include "squeue.h"
+#include <pthread.h>
+#include <string>
+using namespace std;
+class Tester;   // forward declaration (for testing purposes)
+
+// A leftist-heap post queue inside a POSIX shared-memory segment, so that local
+// processes can insert and pop the same posts without serializing them. The
+// segment holds a control block (a process-shared robust mutex, the root and a
+// free list) followed by a fixed pool of nodes. Nodes link to each other by their
+// index in the pool instead of by pointer, since every process maps the segment
+// at a different address. Priority functions cannot be shared across processes:
+// each process passes its own, and the inserting side stores the priority in the node
+class SharedSQueue{
+    public:
+    friend class Tester; // for testing purposes
+
+    // Creates the segment name (e.g. "/feed") with room for capacity posts; it must not exist yet
+    SharedSQueue(const string& name, prifn_t priFn, HEAPTYPE heapType, int capacity);
+    // Opens a segment created by another SharedSQueue, possibly in another process
+    SharedSQueue(const string& name, prifn_t priFn);
+    ~SharedSQueue(); // Unmaps the segment; it exists until unlink()
+    SharedSQueue(const SharedSQueue& rhs) = delete; // one mapping per object
+    SharedSQueue& operator=(const SharedSQueue& rhs) = delete;
+    bool insertPost(const Post& post); // false if invalid or the segment is full
+    int insertPosts(const Post posts[], int count); // Under one lock; returns posts inserted
+    Post getNextPost(); // Returns the highest priority post
+    int getNextPosts(Post posts[], int count); // Up to count posts under one lock; returns how many
+    int numPosts() const;
+    int getCapacity() const;
+    HEAPTYPE getHeapType() const;
+    static void unlink(const string& name); // Removes the segment name; mappings stay valid
+
+    private:
+    static const int NONE = -1; // index of a missing node
+
+    // A post in the pool, linked to its children by index
+    struct Node{
+        uint64_t m_payload;
+        int m_rank;     // priority, negated for a MINHEAP so that higher is better
+        int m_left;
+        int m_right;    // next free node while the node is unused
+        int m_npl;
+    };
+    // Shared state at the start of the segment
+    struct Control{
+        unsigned m_magic;       // set once the segment is initialized
+        int m_capacity;
+        int m_heapType;
+        int m_root;
+        int m_size;
+        int m_free;             // first node of the free list
+        int m_fresh;            // first node never used yet
+        pthread_mutex_t m_lock; // process-shared and robust
+    };
+
+    prifn_t m_priorFunc;    // this process's priority function
+    Control* m_control;     // start of the mapping
+    Node* m_nodes;          // node pool following the control block
+    size_t m_length;        // length of the mapping
+
+    void map(int fd, size_t length);
+    void lock() const;
+    void unlock() const;
+    bool insertLocked(const Post& post);
+    Post popLocked();
+    int merge(int root, int node);
+    static size_t segmentLength(int capacity);
+};
+#endif
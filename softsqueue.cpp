@@ -0,0 +1,275 @@
+
+#include "softsqueue.h"
+#include <cmath>
+
+const int SOFTBLOCK = 4096; // posts or nodes allocated at a time
+
+// SoftSQueue constructor: an empty queue corrupting at most errorRate * n posts
+SoftSQueue::SoftSQueue(prifn_t priFn, HEAPTYPE heapType, double errorRate) {
+    if (!(errorRate > 0 && errorRate <= 0.5))
+        throw out_of_range("Invalid error rate");
+    m_priorFunc = priFn;
+    m_heapType = heapType;
+    m_errorRate = errorRate;
+    m_threshold = (int)ceil(log2(1 / errorRate)) + 5; // keeps the corruption within errorRate * n
+    m_size = 0;
+    m_head = nullptr;
+    m_freeItems = nullptr;
+    m_freeNodes = nullptr;
+}
+
+SoftSQueue::~SoftSQueue() {
+    clear();
+}
+
+// Inserts a post as a tree of rank 0
+bool SoftSQueue::insertPost(const Post& post) {
+    int priority = m_priorFunc(post);
+    if (priority == 0) // Invalid priority, as for SQueue::insertPost
+        return false;
+    Item* item = newItem();
+    item->m_payload = post.getPayload();
+    item->m_key = (m_heapType == MAXHEAP) ? -priority : priority;
+    item->m_next = nullptr;
+    Node* node = newNode();
+    node->m_first = item;
+    node->m_last = item;
+    node->m_count = 1;
+    node->m_key = item->m_key;
+    node->m_rank = 0;
+    node->m_size = 1;
+    node->m_left = nullptr;
+    node->m_right = nullptr;
+    addTree(node);
+    m_size++;
+    return true;
+}
+
+// Removes the first post of the root with the lowest key; the root's list is
+// refilled from its children once it is down to half its size
+Post SoftSQueue::getNextPost() {
+    if (m_head == nullptr)
+        throw out_of_range("Empty Queue");
+    Node* root = m_head->m_suffixMin;
+    Item* item = root->m_first;
+    root->m_first = item->m_next;
+    if (root->m_first == nullptr)
+        root->m_last = nullptr;
+    root->m_count--;
+    Post post(item->m_payload);
+    freeItem(item);
+    m_size--;
+
+    if (root->m_count <= root->m_size / 2 && !isLeaf(root))
+        sift(root);
+    if (root->m_count > 0)
+        updateSuffixMin(root);
+    else{ // An empty leaf: the tree is gone
+        Node* prev = root->m_prev;
+        if (prev != nullptr)
+            prev->m_next = root->m_next;
+        else
+            m_head = root->m_next;
+        if (root->m_next != nullptr)
+            root->m_next->m_prev = prev;
+        freeNode(root);
+        if (prev != nullptr)
+            updateSuffixMin(prev);
+    }
+    return post;
+}
+
+// Returns the post getNextPost() would remove
+Post SoftSQueue::peekNextPost() const {
+    if (m_head == nullptr)
+        throw out_of_range("Empty Queue");
+    return Post(m_head->m_suffixMin->m_first->m_payload);
+}
+
+// Moves the trees of another soft queue into this one, along with the blocks they
+// live in; the free posts and nodes of the other queue are left unused until clear()
+void SoftSQueue::mergeWithQueue(SoftSQueue& rhs) {
+    if (this == &rhs)
+        throw domain_error("Self assignment is not allowed");
+    if (m_priorFunc != rhs.m_priorFunc || m_heapType != rhs.m_heapType || m_errorRate != rhs.m_errorRate)
+        throw runtime_error("SQueues properties mismatch");
+    Node* tree = rhs.m_head;
+    while (tree != nullptr){
+        Node* next = tree->m_next;
+        addTree(tree);
+        tree = next;
+    }
+    m_size += rhs.m_size;
+    m_itemBlocks.insert(m_itemBlocks.end(), rhs.m_itemBlocks.begin(), rhs.m_itemBlocks.end());
+    m_nodeBlocks.insert(m_nodeBlocks.end(), rhs.m_nodeBlocks.begin(), rhs.m_nodeBlocks.end());
+    rhs.m_head = nullptr;
+    rhs.m_size = 0;
+    rhs.m_itemBlocks.clear();
+    rhs.m_nodeBlocks.clear();
+    rhs.m_freeItems = nullptr;
+    rhs.m_freeNodes = nullptr;
+}
+
+int SoftSQueue::numPosts() const {
+    return m_size;
+}
+
+// Counts the posts whose key is better than the key of the list holding them
+int SoftSQueue::numCorrupted() const {
+    int corrupted = 0;
+    for (Node* root = m_head; root != nullptr; root = root->m_next)
+        corrupted += countCorrupted(root);
+    return corrupted;
+}
+
+double SoftSQueue::getErrorRate() const {
+    return m_errorRate;
+}
+
+HEAPTYPE SoftSQueue::getHeapType() const {
+    return m_heapType;
+}
+
+// Removes every post by freeing the blocks
+void SoftSQueue::clear() {
+    for (size_t i = 0; i < m_itemBlocks.size(); i++)
+        delete[] m_itemBlocks[i];
+    for (size_t i = 0; i < m_nodeBlocks.size(); i++)
+        delete[] m_nodeBlocks[i];
+    m_itemBlocks.clear();
+    m_nodeBlocks.clear();
+    m_freeItems = nullptr;
+    m_freeNodes = nullptr;
+    m_head = nullptr;
+    m_size = 0;
+}
+
+// Links a tree into the root list, combining it with roots of the same rank as a
+// binary counter carries, and updates the suffix minima in front of it
+void SoftSQueue::addTree(Node* tree) {
+    Node* prev = nullptr;
+    Node* next = m_head;
+    while (next != nullptr && next->m_rank < tree->m_rank){
+        prev = next;
+        next = next->m_next;
+    }
+    while (next != nullptr && next->m_rank == tree->m_rank){
+        Node* following = next->m_next;
+        tree = combine(next, tree);
+        next = following;
+    }
+    tree->m_prev = prev;
+    tree->m_next = next;
+    if (prev != nullptr)
+        prev->m_next = tree;
+    else
+        m_head = tree;
+    if (next != nullptr)
+        next->m_prev = tree;
+    updateSuffixMin(tree);
+}
+
+// Makes two trees of the same rank the children of a new root and fills its list
+SoftSQueue::Node* SoftSQueue::combine(Node* first, Node* second) {
+    Node* node = newNode();
+    node->m_first = nullptr;
+    node->m_last = nullptr;
+    node->m_count = 0;
+    node->m_key = first->m_key;
+    node->m_rank = first->m_rank + 1;
+    node->m_size = (node->m_rank <= m_threshold) ? 1 : (3 * first->m_size + 1) / 2;
+    node->m_left = first;
+    node->m_right = second;
+    sift(node);
+    return node;
+}
+
+// Fills a node's list up to its size by moving up the list of its child with the
+// lower key, which is refilled in turn. The node takes that child's key: posts it
+// already held with a lower key become corrupted
+void SoftSQueue::sift(Node* node) {
+    while (node->m_count < node->m_size && !isLeaf(node)){
+        if (node->m_left == nullptr || (node->m_right != nullptr && node->m_left->m_key > node->m_right->m_key))
+            swap(node->m_left, node->m_right);
+        Node* child = node->m_left;
+        if (child->m_first != nullptr){
+            if (node->m_last != nullptr)
+                node->m_last->m_next = child->m_first;
+            else
+                node->m_first = child->m_first;
+            node->m_last = child->m_last;
+        }
+        node->m_count += child->m_count;
+        node->m_key = child->m_key;
+        child->m_first = nullptr;
+        child->m_last = nullptr;
+        child->m_count = 0;
+        if (isLeaf(child)){
+            freeNode(child);
+            node->m_left = nullptr;
+        }
+        else
+            sift(child);
+    }
+}
+
+// Recomputes the suffix minima from a root back to the head of the root list
+void SoftSQueue::updateSuffixMin(Node* root) {
+    for (Node* node = root; node != nullptr; node = node->m_prev){
+        if (node->m_next == nullptr || node->m_key <= node->m_next->m_suffixMin->m_key)
+            node->m_suffixMin = node;
+        else
+            node->m_suffixMin = node->m_next->m_suffixMin;
+    }
+}
+
+bool SoftSQueue::isLeaf(const Node* node) {
+    return node->m_left == nullptr && node->m_right == nullptr;
+}
+
+// Counts the corrupted posts of a tree; trees are O(log n) deep
+int SoftSQueue::countCorrupted(const Node* node) {
+    if (node == nullptr)
+        return 0;
+    int corrupted = 0;
+    for (Item* item = node->m_first; item != nullptr; item = item->m_next)
+        if (item->m_key != node->m_key)
+            corrupted++;
+    return corrupted + countCorrupted(node->m_left) + countCorrupted(node->m_right);
+}
+
+// Takes a post off the free list, allocating a block when it is empty
+SoftSQueue::Item* SoftSQueue::newItem() {
+    if (m_freeItems == nullptr){
+        Item* block = new Item[SOFTBLOCK];
+        m_itemBlocks.push_back(block);
+        for (int i = 0; i < SOFTBLOCK; i++)
+            freeItem(&block[i]);
+    }
+    Item* item = m_freeItems;
+    m_freeItems = item->m_next;
+    return item;
+}
+
+// Takes a node off the free list, allocating a block when it is empty
+SoftSQueue::Node* SoftSQueue::newNode() {
+    if (m_freeNodes == nullptr){
+        Node* block = new Node[SOFTBLOCK];
+        m_nodeBlocks.push_back(block);
+        for (int i = 0; i < SOFTBLOCK; i++)
+            freeNode(&block[i]);
+    }
+    Node* node = m_freeNodes;
+    m_freeNodes = node->m_next;
+    return node;
+}
+
+void SoftSQueue::freeItem(Item* item) {
+    item->m_next = m_freeItems;
+    m_freeItems = item;
+}
+
+void SoftSQueue::freeNode(Node* node) {
+    node->m_next = m_freeNodes;
+    m_freeNodes = node;
+}
@@ -0,0 +1,80 @@
+#ifndef SOFTSQUEUE_H
+#define SOFTSQUEUE_H
+#include "squeue.h"
+#include <vector>
+using namespace std;
+class Tester;   // forward declaration (for testing purposes)
+
+// An approximate post queue for feeds that only need one of the best posts. It is
+// a soft heap (Kaplan and Zwick's binary-tree version of Chazelle's soft heap):
+// a node keeps a list of posts under one key, the worst of their keys, so that
+// most pops take a post off a list without any merge work. A post stored under a
+// worse key than its own is corrupted and may come out later than an exact queue
+// would return it. At most errorRate times the number of posts inserted are
+// corrupted at any time.
+// Inserts take O(1) and pops O(log 1/errorRate) amortized time, independent of n.
+// Posts and nodes come from blocks owned by the queue, so clear() is O(blocks)
+class SoftSQueue{
+    public:
+    friend class Tester; // for testing purposes
+
+    // errorRate in (0, 0.5]: the largest fraction of the inserted posts that may be corrupted
+    SoftSQueue(prifn_t priFn, HEAPTYPE heapType, double errorRate);
+    ~SoftSQueue();
+    SoftSQueue(const SoftSQueue& rhs) = delete; // nodes are owned by one queue
+    SoftSQueue& operator=(const SoftSQueue& rhs) = delete;
+    bool insertPost(const Post& post); // false if the priority is invalid
+    Post getNextPost(); // Removes one of the best posts; the best unless it is corrupted
+    Post peekNextPost() const;
+    void mergeWithQueue(SoftSQueue& rhs); // Same priority function, heap type and error rate
+    int numPosts() const;
+    int numCorrupted() const; // Posts stored under a worse key than their own; O(n)
+    double getErrorRate() const;
+    HEAPTYPE getHeapType() const;
+    void clear();
+
+    private:
+    // A post with its key: the priority, negated for a MAXHEAP, so that a lower key is better
+    struct Item{
+        uint64_t m_payload;
+        int m_key;
+        Item* m_next;
+    };
+    // A tree node with its list of posts; roots are also linked in a list ordered by rank
+    struct Node{
+        Item* m_first;
+        Item* m_last;
+        int m_count;        // posts in the list
+        int m_key;          // key of the list, at least the key of each of its posts
+        int m_rank;
+        int m_size;         // posts the list is refilled to: 1 up to rank m_threshold, then x1.5 per rank
+        Node* m_left;
+        Node* m_right;
+        Node* m_next;       // next root, of a higher rank
+        Node* m_prev;
+        Node* m_suffixMin;  // root of the lowest key among this root and the following ones
+    };
+
+    prifn_t m_priorFunc;    // Function to compute priority
+    HEAPTYPE m_heapType;    // either a MINHEAP or a MAXHEAP
+    double m_errorRate;
+    int m_threshold;        // highest rank whose lists hold a single post
+    int m_size;             // posts in the queue
+    Node* m_head;           // root of the lowest rank
+    vector<Item*> m_itemBlocks; // blocks the posts and nodes are carved from,
+    vector<Node*> m_nodeBlocks; // including the ones taken over from merged queues
+    Item* m_freeItems;      // free lists, linked by m_next
+    Node* m_freeNodes;
+
+    Item* newItem();
+    Node* newNode();
+    void freeItem(Item* item);
+    void freeNode(Node* node);
+    void addTree(Node* tree);
+    Node* combine(Node* first, Node* second);
+    void sift(Node* node);
+    void updateSuffixMin(Node* root);
+    static bool isLeaf(const Node* node);
+    static int countCorrupted(const Node* node);
+};
+#endif
@@ -1,36 +1,230 @@
 
 #include "squeue.h" 
+#include <cmath>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+const int RADIXBUCKETS = 33; // bucket 0 plus one bucket per differing bit of a 32 bit priority
+const int DECAYSCALE = 1 << 16; // fixed point scale of log2 priorities in decay keys
+const int PRIORITYBATCH = 256; // posts gathered per batch for priority evaluation
+const int PARALLELSIZE = 1 << 16; // queues smaller than this run whole-tree operations serially
+const size_t EXPORTRECORD = 256; // upper bound on the bytes of one exported post
+const int ADAPTWINDOW = 1024; // operations per sampling window of an AUTO queue
+const double ADAPTMARGIN = 0.75; // a structure must cost at most this fraction of the current one
+const int ADAPTVOTES = 2; // consecutive windows it must win before the queue migrates
+const int ADAPTPAYBACK = 64; // windows in which the savings must repay the O(n) migration
+const double ADAPTINSERTCOST = 32; // steps' worth of allocating a node and computing its priority
+const double ADAPTPOPWEIGHT = 4; // cost of a pop step in a tree (cold nodes) relative to an insert step
+
+// Runs task on a new thread when parallel is set, otherwise runs it right away.
+// The returned thread is only joinable in the first case
+template <class Task>
+static thread forkTask(bool parallel, Task task){
+    if (parallel)
+        return thread(task);
+    task();
+    return thread();
+}
+
+// Frees the nodes of cleared queues on one background thread, in the order they
+// were handed over. It is created on first use and never destroyed, so queues
+// cleared while the program exits can still use it
+class SQueue::Reclaimer{
+    public:
+    Reclaimer() : m_busy(false), m_thread(&Reclaimer::run, this) {
+#ifdef SCHED_IDLE
+        // Lowest scheduling class, so that a wake-up never preempts the thread that
+        // cleared a queue; it still gets a small share of a fully busy CPU
+        sched_param param = {0};
+        pthread_setschedparam(m_thread.native_handle(), SCHED_IDLE, &param);
+#endif
+        m_thread.detach();
+    }
+    // Takes over a tree, its pending roots and its radix buckets in O(1)
+    void reclaim(Post* heap, vector<Post*>& pending, vector< vector< pair<int, Post*> > >& buckets){
+        {
+            lock_guard<mutex> guard(m_lock);
+            m_garbage.push_back(Garbage());
+            m_garbage.back().m_heap = heap;
+            m_garbage.back().m_pending.swap(pending);
+            m_garbage.back().m_buckets.swap(buckets);
+        }
+        m_work.notify_one();
+    }
+    // Waits until everything handed over so far is freed
+    void wait(){
+        unique_lock<mutex> guard(m_lock);
+        m_idle.wait(guard, [this]{ return m_garbage.empty() && !m_busy; });
+    }
+
+    private:
+    struct Garbage{
+        Post* m_heap;
+        vector<Post*> m_pending;
+        vector< vector< pair<int, Post*> > > m_buckets;
+    };
+    mutex m_lock;
+    condition_variable m_work;  // garbage was handed over
+    condition_variable m_idle;  // everything handed over is freed
+    deque<Garbage> m_garbage;
+    bool m_busy;                // the thread is freeing a Garbage taken off the deque
+    thread m_thread;
+
+    void run(){
+        unique_lock<mutex> guard(m_lock);
+        while (true){
+            m_work.wait(guard, [this]{ return !m_garbage.empty(); });
+            Garbage garbage;
+            garbage.m_heap = m_garbage.front().m_heap;
+            garbage.m_pending.swap(m_garbage.front().m_pending);
+            garbage.m_buckets.swap(m_garbage.front().m_buckets);
+            m_garbage.pop_front();
+            m_busy = true;
+            guard.unlock();
+            deleteTree(garbage.m_heap);
+            for (size_t i = 0; i < garbage.m_pending.size(); i++)
+                deleteTree(garbage.m_pending[i]);
+            for (size_t i = 0; i < garbage.m_buckets.size(); i++)
+                for (size_t j = 0; j < garbage.m_buckets[i].size(); j++)
+                    delete garbage.m_buckets[i][j].second;
+            guard.lock();
+            m_busy = false;
+            if (m_garbage.empty())
+                m_idle.notify_all();
+        }
+    }
+};
+
+// Returns the process-wide reclaimer, starting its thread on first use
+SQueue::Reclaimer& SQueue::reclaimer() {
+    static Reclaimer* instance = new Reclaimer();
+    return *instance;
+}
 
 // SQueue constructor: Initializes the queue with a priority function, heap type, and structure
 SQueue::SQueue(prifn_t priFn, HEAPTYPE heapType, STRUCTURE structure) {
     m_heapType = heapType; // Stores whether it's a min-heap or max-heap
     m_structure = structure; // Stores whether it's a skew heap or leftist heap
+    m_adaptive = (structure == AUTO); // AUTO starts as a leftist heap, the best all-round structure
+    if (m_adaptive)
+        m_structure = LEFTIST;
     m_priorFunc = priFn; // Stores the function used to determine post priority
+    m_linear = false; // Priorities come from the function
     m_heap = nullptr; // The root of the heap is initially null
     m_size = 0; // The queue is initially empty
+    m_lazyMerge = false; // Merges are performed eagerly by default
+    m_radixLast = 0; // No priority has been extracted yet
+    m_halfLife = 0; // Priorities do not decay by default
+    m_epoch = 0;
+    m_threads = 1; // Whole-tree operations are serial by default
+    m_forkDepth = 0;
+    m_deferredClear = false; // Nodes are freed on the calling thread by default
+    m_steps = 0;
+    m_lastPopped = 0;
+    m_operations = 0;
+    m_candidate = m_structure;
+    m_votes = 0;
+    resetWindow();
+    if (structure == RADIX && heapType != MINHEAP)
+        throw runtime_error("Radix heap requires a MINHEAP");
+    if (priFn != nullptr) // A linear model queue delegates here with no function
+        if (TraceRecorder::Call recorder; recorder)
+            recorder->recordCreate(*this);
+}
+
+// SQueue constructor for a declarative linear priority model
+SQueue::SQueue(const LinearPriority& model, HEAPTYPE heapType, STRUCTURE structure)
+    : SQueue((prifn_t)nullptr, heapType, structure) {
+    m_linear = true;
+    m_model = model;
+    if (TraceRecorder::Call recorder; recorder)
+        recorder->recordCreate(*this);
 }
 
 // SQueue destructor: Cleans up all allocated memory when the object is destroyed
 SQueue::~SQueue() {
+    if (TraceRecorder::Call recorder; recorder)
+        recorder->recordRemoval(*this, TRACEDESTROY);
     clear(); // Calls the clear function to deallocate nodes
 }
 
 // Clears all nodes from the queue and resets member variables to default states
 void SQueue::clear() {
-    m_heap = clearQueue(m_heap); // Recursively deletes all nodes in the heap
+    if (TraceRecorder::Call recorder; recorder)
+        recorder->recordRemoval(*this, TRACECLEAR);
+    if (m_deferredClear){
+        // Hand the detached tree, pending roots and radix buckets to the reclaimer
+        if (m_heap != nullptr || !m_pending.empty() || !m_buckets.empty())
+            reclaimer().reclaim(m_heap, m_pending, m_buckets);
+        m_heap = nullptr;
+    }
+    m_heap = clearQueue(m_heap); // Deletes all nodes in the heap
+    for (size_t i = 0; i < m_pending.size(); i++) // Delete roots that were never consolidated
+        clearQueue(m_pending[i]);
+    m_pending.clear();
+    for (size_t i = 0; i < m_buckets.size(); i++) // Delete the nodes held by the radix heap
+        for (size_t j = 0; j < m_buckets[i].size(); j++)
+            delete m_buckets[i][j].second;
+    m_buckets.clear();
+    m_radixLast = 0;
+    m_halfLife = 0; // Reset time decay
+    m_epoch = 0;
     m_size = 0; // Reset size to 0
     m_priorFunc = nullptr; // Clear priority function pointer
+    m_linear = false; // Clear priority model
+    m_model = LinearPriority();
     m_heapType = MINHEAP; // Reset heap type to default
     m_structure = SKEW; // Reset structure to default
+    m_lazyMerge = false; // Reset merge mode to default
+    m_adaptive = false; // Reset AUTO mode and its decisions
+    m_changes.clear();
+    m_operations = 0;
 }
 
 // Copy constructor: Performs a deep copy of another SQueue object
 SQueue::SQueue(const SQueue& rhs) {
     m_size = rhs.m_size; // Copy the size
+    m_threads = rhs.m_threads; // Copy the thread settings before the tree is copied
+    m_forkDepth = rhs.m_forkDepth;
+    m_deferredClear = rhs.m_deferredClear;
+    m_steps = 0;
+    m_adaptive = rhs.m_adaptive; // Copy the AUTO mode and its decisions; sampling starts over
+    m_lastPopped = rhs.m_lastPopped;
+    m_operations = rhs.m_operations;
+    m_changes = rhs.m_changes;
+    m_candidate = rhs.m_structure;
+    m_votes = 0;
+    resetWindow();
     m_heapType = rhs.m_heapType; // Copy the heap type
     m_structure = rhs.m_structure; // Copy the structure type
     m_priorFunc = rhs.m_priorFunc; // Copy the priority function pointer
+    m_linear = rhs.m_linear; // Copy the priority model
+    m_model = rhs.m_model;
+    m_lazyMerge = rhs.m_lazyMerge; // Copy the merge mode
+    m_halfLife = rhs.m_halfLife; // Copy the time decay settings
+    m_epoch = rhs.m_epoch;
     m_heap = copyTree( rhs.m_heap); // Recursively deep copy the heap tree structure
+    for (size_t i = 0; i < rhs.m_pending.size(); i++) // Deep copy the pending roots as well
+        m_pending.push_back(copyTree(rhs.m_pending[i]));
+    m_radixLast = rhs.m_radixLast; // Copy the radix heap bound and its buckets
+    m_buckets = rhs.m_buckets;
+    for (size_t i = 0; i < m_buckets.size(); i++)
+        for (size_t j = 0; j < m_buckets[i].size(); j++)
+            m_buckets[i][j].second = copyTree(m_buckets[i][j].second);
+    if (TraceRecorder::Call recorder; recorder)
+        recorder->recordCopy(*this, rhs, TRACECOPY);
 }
 
 // Assignment operator: Allows assigning one SQueue object to another
@@ -44,25 +238,158 @@ SQueue& SQueue::operator=(const SQueue& rhs) {
     
     // Copy member variables from the right-hand side object
     m_size = rhs.m_size;
+    m_threads = rhs.m_threads;
+    m_forkDepth = rhs.m_forkDepth;
+    m_deferredClear = rhs.m_deferredClear;
+    m_steps = 0;
+    m_adaptive = rhs.m_adaptive; // Copy the AUTO mode and its decisions; sampling starts over
+    m_lastPopped = rhs.m_lastPopped;
+    m_operations = rhs.m_operations;
+    m_changes = rhs.m_changes;
+    m_candidate = rhs.m_structure;
+    m_votes = 0;
+    resetWindow();
     m_heapType = rhs.m_heapType;
     m_structure = rhs.m_structure;
     m_priorFunc = rhs.m_priorFunc;
+    m_linear = rhs.m_linear;
+    m_model = rhs.m_model;
+    m_lazyMerge = rhs.m_lazyMerge;
+    m_halfLife = rhs.m_halfLife;
+    m_epoch = rhs.m_epoch;
     // Perform a deep copy of the right-hand side's heap tree
     m_heap = copyTree(rhs.m_heap);
+    for (size_t i = 0; i < rhs.m_pending.size(); i++)
+        m_pending.push_back(copyTree(rhs.m_pending[i]));
+    m_radixLast = rhs.m_radixLast;
+    m_buckets = rhs.m_buckets;
+    for (size_t i = 0; i < m_buckets.size(); i++)
+        for (size_t j = 0; j < m_buckets[i].size(); j++)
+            m_buckets[i][j].second = copyTree(m_buckets[i][j].second);
+    // Recorded last, after the clear() above
+    if (TraceRecorder::Call recorder; recorder)
+        recorder->recordCopy(*this, rhs, TRACEASSIGN);
 
     return *this; // Return reference to the current object
 }
 
-// Merges another SQueue into the current SQueue
-void SQueue::mergeWithQueue(SQueue& rhs) {
+// Merges another SQueue into the current SQueue; with convert, the RHS may be
+// configured differently and is re-keyed for this queue
+void SQueue::mergeWithQueue(SQueue& rhs, bool convert) {
     // Prevent merging a queue with itself
     if (this == &rhs)
         throw domain_error("Self assignment is not allowed");
-    
+    bool sameConfig = (m_heapType == rhs.m_heapType && m_priorFunc == rhs.m_priorFunc && m_linear == rhs.m_linear
+                       && m_model == rhs.m_model && m_halfLife == rhs.m_halfLife);
+
+    // Posts of a queue on another epoch are re-keyed for this queue's clock too
+    if (convert && (m_structure != rhs.m_structure || !sameConfig || m_epoch != rhs.m_epoch)){
+        long long steps = m_steps;
+        int merged = rhs.m_size;
+        adopt(rhs);
+        if (TraceRecorder::Call recorder; recorder)
+            recorder->recordMerge(*this, rhs, convert);
+        if (m_adaptive){
+            m_window.m_merges++;
+            m_window.m_mergedNodes += merged;
+            m_window.m_mergeSteps += m_steps - steps;
+            countOperation();
+        }
+        return;
+    }
+
+    // AUTO queues may have picked different structures; the RHS is converted to
+    // this queue's one (a pairing heap if that is an AUTO radix heap, whose bound it
+    // may break). Everything that can make the merge fail is checked first, so that
+    // neither queue is converted by a merge that then throws
+    bool convertRhs = (m_structure != rhs.m_structure && (m_adaptive || rhs.m_adaptive));
+    if (!sameConfig || (m_structure != rhs.m_structure && !convertRhs))
+        throw runtime_error("SQueues properties mismatch");
+    if (convertRhs && m_structure == RADIX && !m_adaptive){
+        // The roots of the RHS tree and its pending trees hold its lowest priorities
+        if (rhs.m_heap != nullptr && rhs.priority(*rhs.m_heap) < m_radixLast)
+            throw domain_error("Monotone priority violated");
+        for (size_t i = 0; i < rhs.m_pending.size(); i++)
+            if (rhs.priority(*rhs.m_pending[i]) < m_radixLast)
+                throw domain_error("Monotone priority violated");
+    }
+
+    if (convertRhs){
+        if (m_structure == RADIX && m_adaptive)
+            forceStructure(PAIRING);
+        rhs.changeStructure(m_structure);
+    }
+    if (m_adaptive && m_structure == RADIX){
+        bool monotone = true;
+        for (size_t i = 0; i < rhs.m_buckets.size() && monotone; i++)
+            for (size_t j = 0; j < rhs.m_buckets[i].size() && monotone; j++)
+                monotone = rhs.m_buckets[i][j].first >= m_radixLast;
+        if (!monotone){ // AUTO leaves the radix heap instead of throwing
+            forceStructure(PAIRING);
+            rhs.changeStructure(PAIRING);
+        }
+    }
+
+    long long steps = m_steps;
+    int merged = rhs.m_size;
+    meld(rhs);
+    // Recorded once it succeeded: a merge rejected by the checks of adopt() or
+    // meld() leaves both queues unchanged and is not replayed
+    if (TraceRecorder::Call recorder; recorder)
+        recorder->recordMerge(*this, rhs, convert);
+    if (m_adaptive){
+        m_window.m_merges++;
+        m_window.m_mergedNodes += merged;
+        m_window.m_mergeSteps += m_steps - steps;
+        countOperation();
+    }
+}
+
+// Moves the posts of a queue with the same properties into this one
+void SQueue::meld(SQueue& rhs) {
     // Check for consistency in queue properties before merging
-    if (m_structure != rhs.m_structure || m_heapType != rhs.m_heapType || m_priorFunc != rhs.m_priorFunc)
+    if (m_structure != rhs.m_structure || m_heapType != rhs.m_heapType || m_priorFunc != rhs.m_priorFunc
+        || m_linear != rhs.m_linear || !(m_model == rhs.m_model)
+        || m_halfLife != rhs.m_halfLife)
         throw runtime_error("SQueues properties mismatch");
+
+    // Radix heap entries are moved bucket by bucket; every one of them must
+    // respect the monotone bound of this queue, which is checked up front
+    if (m_structure == RADIX){
+        for (size_t i = 0; i < rhs.m_buckets.size(); i++)
+            for (size_t j = 0; j < rhs.m_buckets[i].size(); j++)
+                if (rhs.m_buckets[i][j].first < m_radixLast)
+                    throw domain_error("Monotone priority violated");
+        rebaseEpochs(rhs);
+        for (size_t i = 0; i < rhs.m_buckets.size(); i++){
+            for (size_t j = 0; j < rhs.m_buckets[i].size(); j++)
+                radixPush(rhs.m_buckets[i][j].second, rhs.m_buckets[i][j].first);
+            rhs.m_buckets[i].clear();
+        }
+        m_size += rhs.m_size;
+        rhs.m_size = 0;
+        return;
+    }
     
+    // A post keeps its age: the RHS nodes move onto this queue's clock
+    rebaseEpochs(rhs);
+
+    // In lazy mode the RHS roots are only linked into the pending list in O(1);
+    // the real merge work is deferred until the root is needed
+    if (m_lazyMerge){
+        if (rhs.m_heap != nullptr)
+            m_pending.push_back(rhs.m_heap);
+        m_pending.insert(m_pending.end(), rhs.m_pending.begin(), rhs.m_pending.end());
+        m_size += rhs.m_size;
+        rhs.m_heap = nullptr;
+        rhs.m_pending.clear();
+        rhs.m_size = 0;
+        return;
+    }
+
+    // A lazy RHS must be consolidated before its heap can be merged eagerly
+    rhs.consolidate();
+
     // Transfer nodes from the right-hand side queue to the calling queue
     if (rhs.m_heap != nullptr){ // Only merge if the RHS heap is not empty
         if (m_heap == nullptr){ // If the current heap is empty, just take RHS's heap
@@ -71,10 +398,7 @@ void SQueue::mergeWithQueue(SQueue& rhs) {
         }
         else{
             // Merge the RHS heap into the current heap based on its structure
-            if (m_structure == SKEW)
-                m_heap = mergeSkew(m_heap, rhs.m_heap);
-            else if(m_structure == LEFTIST)
-                m_heap = mergeLeftist(m_heap, rhs.m_heap);
+            m_heap = merge(m_heap, rhs.m_heap);
 
             // Increase the size of the current queue after merging
             m_size += rhs.m_size;
@@ -86,26 +410,197 @@ void SQueue::mergeWithQueue(SQueue& rhs) {
     }
 }
 
+// Moves the posts of a differently configured queue into this one in O(n), without
+// popping or allocating: the RHS nodes are gathered, their priorities evaluated in
+// batches with this queue's function or model, and their keys rebuilt with this
+// queue's heap type and decay (a post keeps its age in epochs). The nodes are then
+// merged pairwise as insertPosts does, which heapifies them in linear time.
+// Posts whose priority is invalid for this queue are deleted, as insertPost would
+// reject them. Nothing changes if a radix heap would receive a priority below its bound
+void SQueue::adopt(SQueue& rhs) {
+    vector<Post*> nodes;
+    for (size_t i = 0; i < rhs.m_buckets.size(); i++)
+        for (size_t j = 0; j < rhs.m_buckets[i].size(); j++)
+            nodes.push_back(rhs.m_buckets[i][j].second);
+    if (rhs.m_heap) nodes.push_back(rhs.m_heap);
+    nodes.insert(nodes.end(), rhs.m_pending.begin(), rhs.m_pending.end());
+    if (rhs.m_structure != RADIX)
+        for (size_t next = 0; next < nodes.size(); next++){
+            if (nodes[next]->m_left) nodes.push_back(nodes[next]->m_left);
+            if (nodes[next]->m_right) nodes.push_back(nodes[next]->m_right);
+        }
+
+    vector<int> priorities(nodes.size());
+    for (size_t start = 0; start < nodes.size(); start += PRIORITYBATCH)
+        evaluate(&nodes[start], (int)min((size_t)PRIORITYBATCH, nodes.size() - start), &priorities[start]);
+    if (m_structure == RADIX){
+        bool monotone = true;
+        for (size_t i = 0; i < nodes.size() && monotone; i++)
+            monotone = priorities[i] == 0 || priorities[i] >= m_radixLast;
+        if (!monotone && m_adaptive) // AUTO leaves the radix heap instead of throwing
+            forceStructure(PAIRING);
+        else if (!monotone)
+            throw domain_error("Monotone priority violated");
+    }
+
+    // The RHS is left empty with its own configuration
+    for (size_t i = 0; i < rhs.m_buckets.size(); i++)
+        rhs.m_buckets[i].clear();
+    rhs.m_heap = nullptr;
+    rhs.m_pending.clear();
+    rhs.m_size = 0;
+
+    for (size_t i = 0; i < nodes.size(); i++){
+        Post* node = nodes[i];
+        if (priorities[i] == 0){
+            delete node;
+            continue;
+        }
+        node->m_left = nullptr;
+        node->m_right = nullptr;
+        node->m_npl = 0;
+        node->m_epoch = m_epoch - (rhs.m_epoch - node->m_epoch);
+        m_size++;
+        if (m_structure == RADIX){
+            node->m_key = priorities[i];
+            radixPush(node, priorities[i]);
+        }
+        else{
+            node->m_key = makeKey(priorities[i], node->m_epoch);
+            m_pending.push_back(node);
+        }
+    }
+    if (!m_lazyMerge)
+        consolidate();
+}
+
+// Rebases the insertion epochs of the RHS nodes on this queue's epoch, keeping
+// the age of every post. With decay a key is log2(priority) plus or minus the
+// epoch, so all RHS keys shift by the same amount and its heap order still holds
+void SQueue::rebaseEpochs(SQueue& rhs) {
+    int shift = m_epoch - rhs.m_epoch;
+    if (shift == 0)
+        return;
+    vector<Post*> nodes;
+    for (size_t i = 0; i < rhs.m_buckets.size(); i++)
+        for (size_t j = 0; j < rhs.m_buckets[i].size(); j++)
+            nodes.push_back(rhs.m_buckets[i][j].second);
+    if (rhs.m_heap) nodes.push_back(rhs.m_heap);
+    nodes.insert(nodes.end(), rhs.m_pending.begin(), rhs.m_pending.end());
+    if (rhs.m_structure != RADIX)
+        for (size_t next = 0; next < nodes.size(); next++){
+            if (nodes[next]->m_left) nodes.push_back(nodes[next]->m_left);
+            if (nodes[next]->m_right) nodes.push_back(nodes[next]->m_right);
+        }
+
+    long long keyShift = 0;
+    if (m_halfLife != 0)
+        keyShift = (m_heapType == MAXHEAP ? 1 : -1) * (long long)shift * DECAYSCALE;
+    for (size_t i = 0; i < nodes.size(); i++){
+        nodes[i]->m_epoch += shift;
+        nodes[i]->m_key += keyShift;
+    }
+}
+
 // Inserts a new Post into the queue
 bool SQueue::insertPost(const Post& post) {
+    if (TraceRecorder::Call recorder; recorder)
+        recorder->record(*this, TRACEINSERT, post.m_payload);
     // Return false if the post's priority is invalid (as determined by the priority function)
-    if (m_priorFunc(post) == 0)
+    int priority = this->priority(post);
+    if (priority == 0)
         return false;
 
+    if (m_adaptive){
+        if (m_heapType == MINHEAP && makeKey(priority, m_epoch) < m_lastPopped)
+            m_window.m_breaks++;
+        if (m_structure == RADIX && priority < m_radixLast) // AUTO leaves the radix heap instead of throwing
+            forceStructure(PAIRING);
+    }
+
+    // A radix heap only accepts priorities that are not below the last extracted one
+    if (m_structure == RADIX && priority < m_radixLast)
+        throw domain_error("Monotone priority violated");
+    long long steps = m_steps;
+
     // Create a new Post object on the heap
-    Post* newPost = new Post(post.m_postID, post.m_likes, post.m_connectLevel, post.m_postTime, post.m_interestLevel);
+    Post* newPost = new Post(post.m_payload);
+    newPost->m_epoch = m_epoch;
+    newPost->m_key = makeKey(priority, m_epoch);
     
     // Merge the new post into the heap based on the current structure
-    if(m_structure == SKEW)
-        m_heap = mergeSkew( m_heap, newPost );
-    else if (m_structure == LEFTIST)
-        m_heap = mergeLeftist(m_heap, newPost);
+    if (m_structure == RADIX)
+        radixPush(newPost, priority);
+    else
+        m_heap = merge(m_heap, newPost);
 
     m_size++; // Increment the total number of posts in the queue
-    
+
+    if (m_adaptive){
+        m_window.m_inserts++;
+        m_window.m_insertSteps += m_steps - steps;
+        countOperation();
+    }
     return true; // Insertion successful
 }
 
+// Inserts a batch of posts: priorities are evaluated in batches (with SIMD for a
+// linear model) and the new nodes are merged pairwise, which builds a heap of
+// the batch in O(count) before it is merged in. In lazy mode the new nodes are
+// left pending. Posts with an invalid priority are skipped
+int SQueue::insertPosts(const Post posts[], int count) {
+    if (TraceRecorder::Call recorder; recorder)
+        recorder->recordInserts(*this, posts, count);
+    vector<const Post*> batch(count);
+    vector<int> priorities(count);
+    for (int i = 0; i < count; i++)
+        batch[i] = &posts[i];
+    evaluate(batch.data(), count, priorities.data());
+
+    if (m_adaptive){
+        for (int i = 0; i < count; i++){
+            if (priorities[i] == 0)
+                continue;
+            if (m_heapType == MINHEAP && makeKey(priorities[i], m_epoch) < m_lastPopped)
+                m_window.m_breaks++;
+            if (m_structure == RADIX && priorities[i] < m_radixLast) // AUTO leaves the radix heap instead
+                forceStructure(PAIRING);
+        }
+    }
+
+    // A radix heap rejects the whole batch if one post breaks the monotone contract
+    if (m_structure == RADIX)
+        for (int i = 0; i < count; i++)
+            if (priorities[i] != 0 && priorities[i] < m_radixLast)
+                throw domain_error("Monotone priority violated");
+    long long steps = m_steps;
+
+    int inserted = 0;
+    for (int i = 0; i < count; i++){
+        if (priorities[i] == 0)
+            continue;
+        const Post& post = posts[i];
+        Post* newPost = new Post(post.m_payload);
+        newPost->m_epoch = m_epoch;
+        newPost->m_key = makeKey(priorities[i], m_epoch);
+        if (m_structure == RADIX)
+            radixPush(newPost, priorities[i]);
+        else
+            m_pending.push_back(newPost);
+        inserted++;
+    }
+    m_size += inserted;
+
+    if (!m_lazyMerge)
+        consolidate();
+    if (m_adaptive){
+        m_window.m_inserts += inserted;
+        m_window.m_insertSteps += m_steps - steps;
+        countOperation(inserted);
+    }
+    return inserted;
+}
+
 // Returns the current number of posts in the queue
 int SQueue::numPosts() const {
     return m_size; // The size of the tree represents the number of posts
@@ -118,6 +613,32 @@ prifn_t SQueue::getPriorityFn() const {
 
 // Retrieves and removes the next highest (or lowest, depending on heap type) priority post
 Post SQueue::getNextPost() {
+    if (TraceRecorder::Call recorder; recorder)
+        recorder->record(*this, TRACEPOP);
+    // A radix heap takes its minimum from bucket 0
+    if (m_structure == RADIX){
+        if (m_size == 0)
+            throw out_of_range("Empty Queue");
+        long long steps = m_steps;
+        radixSettle();
+        Post* node = m_buckets[0].back().second;
+        m_buckets[0].pop_back();
+        Post nextPost = *node;
+        delete node;
+        m_size--;
+        if (m_adaptive){
+            m_lastPopped = nextPost.m_key;
+            m_window.m_pops++;
+            m_window.m_popSteps += m_steps - steps;
+            countOperation();
+        }
+        return nextPost;
+    }
+
+    // Lazily melded roots have to be merged before the true root is known
+    long long steps = m_steps;
+    consolidate();
+
     // Throw an error if the queue is empty
     if (m_heap == nullptr)
         throw out_of_range("Empty Queue");
@@ -133,29 +654,153 @@ Post SQueue::getNextPost() {
     m_size--; // Decrement the size
 
     // Merge the left and right subtrees to form the new heap root, based on structure
-    if (m_structure == SKEW)
-        m_heap = mergeSkew(leftSubtree, rightSubtree);
-    else if (m_structure == LEFTIST)
-        m_heap = mergeLeftist(leftSubtree, rightSubtree);
-    
+    // (a pairing heap root has no right subtree; its children are paired instead)
+    if (m_structure == PAIRING)
+        m_heap = pairChildren(leftSubtree);
+    else
+        m_heap = merge(leftSubtree, rightSubtree);
+
+    if (m_adaptive){ // Sample the operation after the heap is whole again
+        m_lastPopped = nextPost.m_key;
+        m_window.m_pops++;
+        m_window.m_popSteps += m_steps - steps;
+        countOperation();
+    }
     return nextPost; // Return the extracted post
 }
 
+// Returns the next highest (or lowest) priority post without removing it
+Post SQueue::peekNextPost() {
+    if (m_structure == RADIX){
+        if (m_size == 0)
+            throw out_of_range("Empty Queue");
+        radixSettle();
+        return *m_buckets[0].back().second;
+    }
+    consolidate(); // The root is only meaningful once pending roots are merged
+    if (m_heap == nullptr)
+        throw out_of_range("Empty Queue");
+    return *m_heap;
+}
+
 // Changes the priority function and heap type, then rebuilds the heap
 void SQueue::setPriorityFn(prifn_t priFn, HEAPTYPE heapType) {
-    // If the heap type is already the same, do nothing
-    if (m_heapType == heapType)
+    if (TraceRecorder::Call recorder; recorder)
+        recorder->recordPriorityFn(*this, priFn, heapType);
+    // If the function and heap type are already the same, do nothing (unless a priority model is replaced)
+    if (m_priorFunc == priFn && m_heapType == heapType && !m_linear)
         return;
+    if (m_structure == RADIX && heapType != MINHEAP && m_adaptive)
+        forceStructure(PAIRING);
+    if (m_structure == RADIX && heapType != MINHEAP) // A radix heap only supports MINHEAP consumption
+        throw runtime_error("Radix heap requires a MINHEAP");
+    consolidate(); // Pending roots are rebuilt together with the main heap
+
+    // A radix heap is rekeyed through a tree, which refiles every node afterwards
+    bool radix = (m_structure == RADIX);
+    if (radix)
+        changeStructure(PAIRING);
+
     m_priorFunc = priFn; // Set the new priority function
+    m_linear = false;
     m_heapType = heapType; // Set the new heap type
-    m_heap = rebuildHeap(m_heap); // Rebuild the entire heap with the new priority logic
+    refreshKeys(m_heap); // Cached keys follow the new priority function
+    rebuild(); // Rebuild the entire heap with the new priority logic
+
+    if (radix)
+        changeStructure(RADIX);
+}
+
+// Replaces the priority with a linear model; the keys of all nodes are
+// re-evaluated in SIMD batches and the heap is rebuilt
+void SQueue::setPriorityModel(const LinearPriority& model, HEAPTYPE heapType) {
+    if (TraceRecorder::Call recorder; recorder)
+        recorder->recordPriorityModel(*this, model, heapType);
+    if (m_structure == RADIX && heapType != MINHEAP && m_adaptive)
+        forceStructure(PAIRING);
+    if (m_structure == RADIX && heapType != MINHEAP)
+        throw runtime_error("Radix heap requires a MINHEAP");
+    consolidate(); // Pending roots are rebuilt together with the main heap
+
+    // A radix heap is rekeyed through a tree, which refiles every node afterwards
+    bool radix = (m_structure == RADIX);
+    if (radix)
+        changeStructure(PAIRING);
+
+    m_priorFunc = nullptr;
+    m_linear = true;
+    m_model = model;
+    m_heapType = heapType;
+    refreshKeys(m_heap);
+    rebuild();
+
+    if (radix)
+        changeStructure(RADIX);
 }
 
-// Changes the underlying heap structure (Skew or Leftist)
+// Returns whether priorities come from a linear model
+bool SQueue::hasPriorityModel() const {
+    return m_linear;
+}
+
+// Changes the underlying heap structure (Skew, Leftist, Pairing or Radix), which
+// ends AUTO mode; AUTO keeps the current structure and lets the queue adapt it
 void SQueue::setStructure(STRUCTURE structure){
+    if (TraceRecorder::Call recorder; recorder)
+        recorder->record(*this, TRACESTRUCTURE, structure);
+    if (structure == AUTO){
+        if (!m_adaptive){
+            m_adaptive = true;
+            m_candidate = m_structure;
+            m_votes = 0;
+            resetWindow();
+        }
+        return;
+    }
+    changeStructure(structure);
+    m_adaptive = false;
+}
+
+// Converts the heap to another concrete structure
+void SQueue::changeStructure(STRUCTURE structure){
     // Validate the requested structure type
-    if (structure != SKEW && structure != LEFTIST)
+    if (structure != SKEW && structure != LEFTIST && structure != PAIRING && structure != RADIX)
         throw runtime_error("Invalid Heap structure");
+    if (structure == RADIX && m_heapType != MINHEAP)
+        throw runtime_error("Radix heap requires a MINHEAP");
+    if (structure == RADIX && m_halfLife != 0)
+        throw runtime_error("Radix heap does not support time decay");
+    if (m_structure == structure)
+        return;
+
+    consolidate(); // Pending roots are converted together with the main heap
+
+    // Leaving the radix heap: the detached nodes are merged pairwise into a new tree
+    if (m_structure == RADIX)
+    {
+        m_structure = structure;
+        collectRadix(m_pending);
+        consolidate();
+        return;
+    }
+
+    // Entering the radix heap: every node is detached and filed under its priority;
+    // the monotone bound is lowered if the tree holds a smaller priority
+    if (structure == RADIX)
+    {
+        vector<Post*> nodes;
+        collectNodes(m_heap, nodes);
+        m_heap = nullptr;
+        m_structure = RADIX;
+        for (size_t i = 0; i < nodes.size(); i++){
+            int priority = this->priority(*nodes[i]);
+            nodes[i]->m_key = priority;
+            if (priority < m_radixLast)
+                m_radixLast = priority;
+            radixPush(nodes[i], priority);
+        }
+        return;
+    }
 
     // If the tree is empty, just update the structure and return
     if(m_heap == nullptr)
@@ -164,6 +809,22 @@ void SQueue::setStructure(STRUCTURE structure){
         return;
     }
 
+    // A pairing heap is first turned into a heap of the requested binary structure
+    if (m_structure == PAIRING && structure != PAIRING)
+    {
+        m_structure = structure; // merge() must already use the target structure
+        m_heap = switchFromPairing(m_heap);
+        return;
+    }
+
+    // Handle transition to the pairing heap structure
+    if (m_structure != PAIRING && structure == PAIRING)
+    {
+        m_heap = switchToPairing(m_heap);
+        m_structure = PAIRING;
+        return;
+    }
+
     // Handle transition from SKEW to Leftist heap structure
     if (m_structure == SKEW && structure == LEFTIST)
     {
@@ -179,11 +840,287 @@ void SQueue::setStructure(STRUCTURE structure){
     }
 }
 
+// Enables or disables lazy merging; disabling it consolidates any pending roots
+void SQueue::setLazyMerge(bool lazy) {
+    if (TraceRecorder::Call recorder; recorder)
+        recorder->record(*this, TRACELAZYMERGE, lazy);
+    if (!lazy)
+        consolidate();
+    m_lazyMerge = lazy;
+}
+
+// Returns whether merges are performed lazily
+bool SQueue::getLazyMerge() const {
+    return m_lazyMerge;
+}
+
+// Enables, changes or disables time decay. With exponential decay the order of
+// two posts never changes as time passes, so advancing the epoch costs nothing;
+// only a change of the half-life rekeys and rebuilds the heap once
+void SQueue::setDecay(int halfLife) {
+    if (TraceRecorder::Call recorder; recorder)
+        recorder->record(*this, TRACEDECAY, (unsigned)halfLife);
+    if (halfLife < 0)
+        throw out_of_range("Invalid half-life");
+    if (halfLife == m_halfLife)
+        return;
+    if (m_structure == RADIX && halfLife != 0 && m_adaptive)
+        forceStructure(PAIRING);
+    if (m_structure == RADIX && halfLife != 0)
+        throw runtime_error("Radix heap does not support time decay");
+
+    consolidate(); // Pending roots are rekeyed together with the main heap
+    m_halfLife = halfLife;
+    refreshKeys(m_heap);
+    rebuild();
+}
+
+// Returns the time decay half-life in epochs (0 when decay is off)
+int SQueue::getDecay() const {
+    return m_halfLife;
+}
+
+// Advances the queue clock; the cached keys stay valid, so no post is touched
+void SQueue::advanceEpoch(int epochs) {
+    if (TraceRecorder::Call recorder; recorder)
+        recorder->record(*this, TRACEEPOCH, (unsigned)epochs);
+    if (epochs < 0)
+        throw out_of_range("Epochs cannot go backwards");
+    m_epoch += epochs;
+}
+
+// Returns the current epoch of the queue
+int SQueue::getEpoch() const {
+    return m_epoch;
+}
+
+// Returns the priority of a post from this queue at the current epoch:
+// priority * 2^(-age/halfLife) for a MAXHEAP and priority * 2^(age/halfLife) for a MINHEAP
+double SQueue::decayedPriority(const Post& post) const {
+    double priority = this->priority(post);
+    if (m_halfLife == 0)
+        return priority;
+    double age = (double)(m_epoch - post.m_epoch) / m_halfLife;
+    return m_heapType == MAXHEAP ? priority * pow(2.0, -age) : priority * pow(2.0, age);
+}
+
+// Sets the number of threads used by copyTree, clearQueue,
+// switchToLeftist and refreshKeys. Subtrees are forked down to a depth of
+// about log2(threads) + 1, which leaves some slack for unbalanced trees;
+// the results are identical to the serial version
+void SQueue::setThreads(int threads) {
+    if (TraceRecorder::Call recorder; recorder)
+        recorder->record(*this, TRACETHREADS, (unsigned)threads);
+    if (threads < 1)
+        throw out_of_range("Invalid number of threads");
+    m_threads = threads;
+    m_forkDepth = 0;
+    while ((1 << m_forkDepth) < threads)
+        m_forkDepth++;
+    if (threads > 1)
+        m_forkDepth++;
+}
+
+// Returns the number of threads used by whole-tree operations
+int SQueue::getThreads() const {
+    return m_threads;
+}
+
+// Sets whether clear() and the destructor defer freeing the nodes to the background reclaimer
+void SQueue::setDeferredClear(bool deferred) {
+    if (TraceRecorder::Call recorder; recorder)
+        recorder->record(*this, TRACEDEFERREDCLEAR, deferred);
+    m_deferredClear = deferred;
+}
+
+// Returns whether clearing is deferred to the background reclaimer
+bool SQueue::getDeferredClear() const {
+    return m_deferredClear;
+}
+
+// Waits until the background reclaimer has freed the nodes of every deferred clear so far
+void SQueue::waitForReclaim() {
+    reclaimer().wait();
+}
+
 // Returns the current heap structure type
 STRUCTURE SQueue::getStructure() const {
     return m_structure;
 }
 
+// Returns whether the queue is in AUTO mode
+bool SQueue::isAdaptive() const {
+    return m_adaptive;
+}
+
+// Returns the structure changes made in AUTO mode, oldest first
+const vector<StructureChange>& SQueue::getStructureChanges() const {
+    return m_changes;
+}
+
+// Prints the structure changes made in AUTO mode and the windows behind them
+void SQueue::printStructureChanges() const {
+    const char* names[] = {"SKEW", "LEFTIST", "PAIRING", "RADIX"};
+    cout << "Structure changes: " << m_changes.size() << "\n";
+    for (size_t i = 0; i < m_changes.size(); i++){
+        const StructureChange& change = m_changes[i];
+        cout << "  after " << change.m_operation << " operations: " << names[change.m_from]
+             << " -> " << names[change.m_to];
+        if (change.m_forced)
+            cout << " (forced: operation not supported by " << names[change.m_from] << ")\n";
+        else
+            cout << " (window of " << change.m_inserts << " inserts, " << change.m_pops << " pops, "
+                 << change.m_merges << " merges; " << change.m_cost << " -> " << change.m_newCost
+                 << " steps per operation)\n";
+    }
+    cout.flush();
+}
+
+// Re-evaluates the structure of an AUTO queue once its sampling window is full
+void SQueue::countOperation(int operations) {
+    m_operations += operations;
+    if (m_window.m_inserts + m_window.m_pops + m_window.m_merges >= ADAPTWINDOW)
+        adaptStructure();
+}
+
+// Picks the structure with the lowest cost for the last window's operations. The
+// cost of the current structure comes from the steps its operations took; the
+// others are modelled, with each operation's model scaled by how far it was off
+// for the current structure, which carries over effects of the key distribution.
+// The queue migrates only when another structure is clearly cheaper (ADAPTMARGIN)
+// for ADAPTVOTES windows in a row, and when the savings repay the O(n) migration
+// within ADAPTPAYBACK windows
+void SQueue::adaptStructure() {
+    double insertSteps, popSteps, mergeSteps;
+    modelSteps(m_structure, insertSteps, popSteps, mergeSteps);
+    double insertScale = calibrate(m_window.m_insertSteps, insertSteps * m_window.m_inserts);
+    double popScale = calibrate(m_window.m_popSteps, popSteps * m_window.m_pops);
+    double mergeScale = calibrate(m_window.m_mergeSteps, mergeSteps * m_window.m_merges);
+    double current = cost(m_structure, m_window.m_insertSteps, m_window.m_popSteps, m_window.m_mergeSteps);
+
+    STRUCTURE best = m_structure;
+    double bestCost = current;
+    STRUCTURE candidates[] = {SKEW, LEFTIST, PAIRING, RADIX};
+    for (int i = 0; i < 4; i++){
+        STRUCTURE candidate = candidates[i];
+        if (candidate == m_structure)
+            continue;
+        // A radix heap needs monotone MINHEAP consumption without decay
+        if (candidate == RADIX && (m_heapType != MINHEAP || m_halfLife != 0 ||
+                                   m_window.m_breaks > 0 || m_window.m_pops == 0))
+            continue;
+        modelSteps(candidate, insertSteps, popSteps, mergeSteps);
+        if (candidate != RADIX){ // radix steps do not depend on the shape of a tree
+            insertSteps *= insertScale;
+            popSteps *= popScale;
+            mergeSteps *= mergeScale;
+        }
+        double estimate = cost(candidate, insertSteps * m_window.m_inserts, popSteps * m_window.m_pops,
+                               mergeSteps * m_window.m_merges);
+        if (estimate < bestCost){
+            best = candidate;
+            bestCost = estimate;
+        }
+    }
+
+    if (best != m_structure && bestCost < ADAPTMARGIN * current &&
+        (current - bestCost) * ADAPTPAYBACK >= m_size){
+        m_votes = (m_candidate == best) ? m_votes + 1 : 1;
+        m_candidate = best;
+        if (m_votes >= ADAPTVOTES){
+            int operations = m_window.m_inserts + m_window.m_pops + m_window.m_merges;
+            StructureChange change;
+            change.m_operation = m_operations;
+            change.m_from = m_structure;
+            change.m_to = best;
+            change.m_inserts = m_window.m_inserts;
+            change.m_pops = m_window.m_pops;
+            change.m_merges = m_window.m_merges;
+            change.m_cost = current / operations;
+            change.m_newCost = bestCost / operations;
+            change.m_forced = false;
+            m_changes.push_back(change);
+            changeStructure(best);
+            m_votes = 0;
+        }
+    }
+    else
+        m_votes = 0;
+    resetWindow();
+}
+
+// Starts a new sampling window
+void SQueue::resetWindow() {
+    m_window.m_inserts = 0;
+    m_window.m_pops = 0;
+    m_window.m_merges = 0;
+    m_window.m_mergedNodes = 0;
+    m_window.m_breaks = 0;
+    m_window.m_insertSteps = 0;
+    m_window.m_popSteps = 0;
+    m_window.m_mergeSteps = 0;
+}
+
+// Modelled steps of one insert, pop and merge on a structure of the current size.
+// With L = log2(n): leftist and skew inserts and merges walk about half a right
+// path and pops about a whole one; pairing inserts and merges link once and pops
+// pair about 1.35 L children; radix inserts file once, pops redistribute about
+// L / 2 entries and merges refile every incoming post
+void SQueue::modelSteps(STRUCTURE structure, double& insert, double& pop, double& merge) const {
+    double logSize = log2((double)m_size + 2);
+    if (structure == SKEW){
+        insert = 0.6 * logSize; pop = 1.1 * logSize; merge = 0.6 * logSize;
+    }
+    else if (structure == LEFTIST){
+        insert = 0.5 * logSize; pop = 1.05 * logSize; merge = 0.5 * logSize;
+    }
+    else if (structure == PAIRING){
+        insert = 1; pop = 1.35 * logSize; merge = 1;
+    }
+    else{
+        insert = 1; pop = 0.5 * logSize;
+        merge = m_window.m_merges > 0 ? (double)m_window.m_mergedNodes / m_window.m_merges : 0;
+    }
+}
+
+// Cost of the window's operations given their steps on a structure. Every insert
+// also allocates a node and computes a priority, and the steps of a pop in a tree
+// touch nodes far apart, which costs more than walking the path an insert just
+// followed; a pairing step links two such nodes, while radix buckets are contiguous
+double SQueue::cost(STRUCTURE structure, double insertSteps, double popSteps, double mergeSteps) const {
+    double popWeight = ADAPTPOPWEIGHT;
+    if (structure == PAIRING)
+        popWeight *= 1.5;
+    else if (structure == RADIX)
+        popWeight = 1;
+    return ADAPTINSERTCOST * m_window.m_inserts + insertSteps + popWeight * popSteps + mergeSteps;
+}
+
+// Ratio of measured to modelled steps, bounded so that one odd window cannot decide alone
+double SQueue::calibrate(double measured, double modelled) {
+    if (measured <= 0 || modelled <= 0)
+        return 1.0;
+    return max(0.25, min(4.0, measured / modelled));
+}
+
+// Moves an AUTO queue to a structure that supports an operation the current one does not
+void SQueue::forceStructure(STRUCTURE structure) {
+    StructureChange change;
+    change.m_operation = m_operations;
+    change.m_from = m_structure;
+    change.m_to = structure;
+    change.m_inserts = m_window.m_inserts;
+    change.m_pops = m_window.m_pops;
+    change.m_merges = m_window.m_merges;
+    change.m_cost = 0;
+    change.m_newCost = 0;
+    change.m_forced = true;
+    m_changes.push_back(change);
+    changeStructure(structure);
+    m_votes = 0;
+    resetWindow();
+}
+
 // Returns the current heap type (MINHEAP or MAXHEAP)
 HEAPTYPE SQueue::getHeapType() const {
     return m_heapType;
@@ -196,33 +1133,215 @@ void SQueue::printPostsQueue() const {
         cout << "There is no post yet" << endl;
         return;
     }
-    cout << "Contents of the queue: " << endl;
-    preorderPrint(m_heap); // Calls the helper function for recursive printing
+    PostSink sink(cout); // One buffered write instead of a flush per post
+    sink.write("Contents of the queue: \n");
+    exportPosts(sink, TEXT);
+}
+
+// Writes every post with its priority: text lines as printed by printPostsQueue,
+// a JSON array, or "SQP1", the post count and six native ints per post
+// (priority, ID, likes, connect level, post time, interest level)
+void SQueue::exportPosts(PostSink& sink, EXPORTFORMAT format) const {
+    if (format == JSON)
+        sink.write("[", 1);
+    else if (format == BINARY){
+        sink.write("SQP1", 4);
+        sink.writeRaw(m_size);
+    }
+    bool first = true;
+    for (size_t i = 0; i < m_buckets.size(); i++) // Radix heap entries, bucket by bucket
+        for (size_t j = 0; j < m_buckets[i].size(); j++)
+            exportTree(m_buckets[i][j].second, sink, format, first);
+    exportTree(m_heap, sink, format, first);
+    for (size_t i = 0; i < m_pending.size(); i++) // Roots that are not consolidated yet
+        exportTree(m_pending[i], sink, format, first);
+    if (format == JSON)
+        sink.write("\n]\n", 3);
 }
 
 // Dumps the internal structure of the heap for debugging
 void SQueue::dump() const {
+    PostSink sink(cout);
     if (m_size == 0) {
-        cout << "Empty heap.\n" ;
+        sink.write("Empty heap.\n");
     } else {
-        dump(m_heap); // Calls the recursive dump helper
+        for (size_t i = 0; i < m_buckets.size(); i++){ // Radix heap buckets as i{(priority:ID)...}
+            if (m_buckets[i].empty()) continue;
+            sink.writeInt((int)i);
+            sink.write("{", 1);
+            for (size_t j = 0; j < m_buckets[i].size(); j++)
+                dump(m_buckets[i][j].second, sink);
+            sink.write("}", 1);
+        }
+        dump(m_heap, sink);
+        for (size_t i = 0; i < m_pending.size(); i++){ // Roots that are not consolidated yet
+            sink.write(" + ", 3);
+            dump(m_pending[i], sink);
+        }
     }
-    cout << endl;
+    sink.write("\n", 1);
 }
 
-// Recursive helper function to dump the heap's structure
-void SQueue::dump(Post *pos) const {
-    if ( pos != nullptr ) {
-        cout << "(";
-        dump(pos->m_left); // Recursively dump left child
-        // Print node information based on heap structure (Leftist includes NPL)
-        if (m_structure == SKEW)
-            cout << m_priorFunc(*pos) << ":" << pos->m_postID;
-        else
-            cout << m_priorFunc(*pos) << ":" << pos->m_postID << ":" << pos->m_npl;
-        dump(pos->m_right); // Recursively dump right child
-        cout << ")";
+// Helper function to dump the heap's structure as (left data right), iteratively.
+// A stack entry (node, false) opens a node, (node, true) prints its data and goes
+// on with its right subtree, (nullptr, true) closes a node
+void SQueue::dump(Post *pos, PostSink& sink) const {
+    vector< pair<Post*, bool> > stack;
+    if (pos != nullptr)
+        stack.push_back(make_pair(pos, false));
+    while (!stack.empty()){
+        pair<Post*, bool> top = stack.back();
+        stack.pop_back();
+        if (top.first == nullptr)
+            sink.write(")", 1);
+        else if (!top.second){
+            sink.write("(", 1);
+            stack.push_back(make_pair(top.first, true));
+            if (top.first->m_left != nullptr)
+                stack.push_back(make_pair(top.first->m_left, false));
+        }
+        else{
+            // Node information based on heap structure (Leftist includes NPL)
+            sink.writeInt(priority(*top.first));
+            sink.write(":", 1);
+            sink.writeInt(top.first->getPostID());
+            if (m_structure == LEFTIST){
+                sink.write(":", 1);
+                sink.writeInt(top.first->m_npl);
+            }
+            stack.push_back(make_pair((Post*)nullptr, true));
+            if (top.first->m_right != nullptr)
+                stack.push_back(make_pair(top.first->m_right, false));
+        }
+    }
+}
+
+// Evaluates the linear model for one post; 0 marks an invalid priority
+int LinearPriority::priority(const Post& post) const {
+    int priority = m_likesWeight * post.getNumLikes() + m_connectWeight * post.getConnectLevel()
+                 + m_timeWeight * post.getPostTime() + m_interestWeight * post.getInterestLevel() + m_bias;
+    if (priority >= m_minValue && priority <= m_maxValue)
+        return priority;
+    return 0;
+}
+
+// Evaluates the linear model over struct-of-arrays input, 8 (AVX2) or 4 (SSE4.1)
+// posts per step; the remainder and builds without SIMD use the scalar loop
+void LinearPriority::evaluate(const int likes[], const int connectLevels[], const int postTimes[],
+                              const int interestLevels[], int priorities[], int count) const {
+    int i = 0;
+#if defined(__AVX2__)
+    const __m256i likesWeight = _mm256_set1_epi32(m_likesWeight);
+    const __m256i connectWeight = _mm256_set1_epi32(m_connectWeight);
+    const __m256i timeWeight = _mm256_set1_epi32(m_timeWeight);
+    const __m256i interestWeight = _mm256_set1_epi32(m_interestWeight);
+    const __m256i bias = _mm256_set1_epi32(m_bias);
+    const __m256i belowMin = _mm256_set1_epi32(m_minValue - 1);
+    const __m256i maxValue = _mm256_set1_epi32(m_maxValue);
+    for (; i + 8 <= count; i += 8){
+        __m256i sum = _mm256_add_epi32(bias, _mm256_mullo_epi32(likesWeight, _mm256_loadu_si256((const __m256i*)(likes + i))));
+        sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(connectWeight, _mm256_loadu_si256((const __m256i*)(connectLevels + i))));
+        sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(timeWeight, _mm256_loadu_si256((const __m256i*)(postTimes + i))));
+        sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(interestWeight, _mm256_loadu_si256((const __m256i*)(interestLevels + i))));
+        // Out of range lanes are zeroed: sum < min or sum > max
+        __m256i invalid = _mm256_or_si256(_mm256_cmpgt_epi32(belowMin, sum), _mm256_cmpgt_epi32(sum, maxValue));
+        _mm256_storeu_si256((__m256i*)(priorities + i), _mm256_andnot_si256(invalid, sum));
+    }
+#elif defined(__SSE4_1__)
+    const __m128i likesWeight = _mm_set1_epi32(m_likesWeight);
+    const __m128i connectWeight = _mm_set1_epi32(m_connectWeight);
+    const __m128i timeWeight = _mm_set1_epi32(m_timeWeight);
+    const __m128i interestWeight = _mm_set1_epi32(m_interestWeight);
+    const __m128i bias = _mm_set1_epi32(m_bias);
+    const __m128i belowMin = _mm_set1_epi32(m_minValue - 1);
+    const __m128i maxValue = _mm_set1_epi32(m_maxValue);
+    for (; i + 4 <= count; i += 4){
+        __m128i sum = _mm_add_epi32(bias, _mm_mullo_epi32(likesWeight, _mm_loadu_si128((const __m128i*)(likes + i))));
+        sum = _mm_add_epi32(sum, _mm_mullo_epi32(connectWeight, _mm_loadu_si128((const __m128i*)(connectLevels + i))));
+        sum = _mm_add_epi32(sum, _mm_mullo_epi32(timeWeight, _mm_loadu_si128((const __m128i*)(postTimes + i))));
+        sum = _mm_add_epi32(sum, _mm_mullo_epi32(interestWeight, _mm_loadu_si128((const __m128i*)(interestLevels + i))));
+        // Out of range lanes are zeroed: sum < min or sum > max
+        __m128i invalid = _mm_or_si128(_mm_cmpgt_epi32(belowMin, sum), _mm_cmpgt_epi32(sum, maxValue));
+        _mm_storeu_si128((__m128i*)(priorities + i), _mm_andnot_si128(invalid, sum));
+    }
+#endif
+    for (; i < count; i++){
+        int priority = m_likesWeight * likes[i] + m_connectWeight * connectLevels[i]
+                     + m_timeWeight * postTimes[i] + m_interestWeight * interestLevels[i] + m_bias;
+        priorities[i] = (priority >= m_minValue && priority <= m_maxValue) ? priority : 0;
+    }
+}
+
+// Two models are equal when all their weights, bias and range are equal
+bool LinearPriority::operator==(const LinearPriority& rhs) const {
+    return m_likesWeight == rhs.m_likesWeight && m_connectWeight == rhs.m_connectWeight
+        && m_timeWeight == rhs.m_timeWeight && m_interestWeight == rhs.m_interestWeight
+        && m_bias == rhs.m_bias && m_minValue == rhs.m_minValue && m_maxValue == rhs.m_maxValue;
+}
+
+// Returns an iterator at the highest priority post. The frontier starts with the
+// roots of the heap and the pending roots; a radix heap has no tree above its
+// entries, so all of them start in the frontier
+SQueue::const_iterator SQueue::begin() const {
+    const_iterator it;
+    it.m_heapType = m_heapType;
+    it.m_pairing = (m_structure == PAIRING);
+    it.push(m_heap);
+    for (size_t i = 0; i < m_pending.size(); i++)
+        it.push(m_pending[i]);
+    for (size_t i = 0; i < m_buckets.size(); i++)
+        for (size_t j = 0; j < m_buckets[i].size(); j++)
+            it.push(m_buckets[i][j].second);
+    return it;
+}
+
+// Returns the past-the-end iterator
+SQueue::const_iterator SQueue::end() const {
+    const_iterator it;
+    it.m_heapType = m_heapType;
+    it.m_pairing = (m_structure == PAIRING);
+    return it;
+}
+
+// Moves to the next post in priority order; the children of the current node
+// become candidates. The children of a pairing heap node are its whole sibling
+// list, since siblings are not ordered among themselves
+SQueue::const_iterator& SQueue::const_iterator::operator++() {
+    const Post* node = m_frontier.front();
+    pop_heap(m_frontier.begin(), m_frontier.end(),
+             [this](const Post* node1, const Post* node2){ return before(node2, node1); });
+    m_frontier.pop_back();
+    if (m_pairing){
+        for (const Post* child = node->m_left; child; child = child->m_right)
+            push(child);
     }
+    else{
+        push(node->m_left);
+        push(node->m_right);
+    }
+    return *this;
+}
+
+// Iterators are equal when both are at the end or at the same node with the same frontier size
+bool SQueue::const_iterator::operator==(const const_iterator& rhs) const {
+    if (m_frontier.empty() || rhs.m_frontier.empty())
+        return m_frontier.empty() == rhs.m_frontier.empty();
+    return m_frontier.front() == rhs.m_frontier.front() && m_frontier.size() == rhs.m_frontier.size();
+}
+
+// Adds a candidate node to the frontier heap
+void SQueue::const_iterator::push(const Post* node) {
+    if (!node) return;
+    m_frontier.push_back(node);
+    push_heap(m_frontier.begin(), m_frontier.end(),
+              [this](const Post* node1, const Post* node2){ return before(node2, node1); });
+}
+
+// Returns true if node1 comes before node2 in priority order
+bool SQueue::const_iterator::before(const Post* node1, const Post* node2) const {
+    if (m_heapType == MINHEAP)
+        return node1->m_key < node2->m_key;
+    return node1->m_key > node2->m_key;
 }
 
 // Overloaded stream insertion operator to print a Post object
@@ -234,35 +1353,190 @@ ostream& operator<<(ostream& sout, const Post& post) {
 }
 
 
-// Helper functions implementation
+// Copies a string literal without its terminator; returns the end of the copy
+template <size_t N>
+static char* appendText(char* out, const char (&text)[N]){
+    memcpy(out, text, N - 1);
+    return out + N - 1;
+}
+
+// Writes an int in decimal; returns the end of the digits
+static char* appendInt(char* out, int value){
+    return to_chars(out, out + 11, value).ptr;
+}
+
+// In-memory sink: the buffer grows as needed and holds everything written
+PostSink::PostSink(size_t capacity) : m_buffer(capacity > 0 ? capacity : 1) {
+    m_used = 0;
+    m_flushed = 0;
+    m_fd = -1;
+    m_out = nullptr;
+}
+
+// Sink streaming to a file descriptor, which stays open afterwards
+PostSink::PostSink(int fd, size_t capacity) : m_buffer(capacity > 0 ? capacity : 1) {
+    if (fd < 0)
+        throw out_of_range("Invalid file descriptor");
+    m_used = 0;
+    m_flushed = 0;
+    m_fd = fd;
+    m_out = nullptr;
+}
+
+// Sink streaming to an ostream
+PostSink::PostSink(ostream& out, size_t capacity) : m_buffer(capacity > 0 ? capacity : 1) {
+    m_used = 0;
+    m_flushed = 0;
+    m_fd = -1;
+    m_out = &out;
+}
+
+// Flushes the rest of the buffer; a failing write cannot be reported here
+PostSink::~PostSink() {
+    try {
+        flush();
+    } catch (const exception&) {}
+}
+
+// Appends bytes to the buffer
+void PostSink::write(const char* data, size_t length) {
+    char* out = reserve(length);
+    memcpy(out, data, length);
+    commit(out + length);
+}
 
-// Recursively deletes all nodes in a heap tree
-Post* SQueue::clearQueue(Post* node){
-    if (!node) return nullptr; // Base case: if node is null, return
+// Appends an int as decimal text
+void PostSink::writeInt(int value) {
+    commit(appendInt(reserve(11), value));
+}
+
+// Appends an int as its native 4 bytes
+void PostSink::writeRaw(int value) {
+    write((const char*)&value, sizeof(value));
+}
+
+// Hands the buffered bytes to the file descriptor or stream; an in-memory sink keeps them
+void PostSink::flush() {
+    if (m_fd >= 0){
+        size_t done = 0;
+        while (done < m_used){
+            ssize_t written = ::write(m_fd, m_buffer.data() + done, m_used - done);
+            if (written < 0){
+                if (errno == EINTR) continue;
+                throw runtime_error("Export write failed");
+            }
+            done += written;
+        }
+    }
+    else if (m_out != nullptr){
+        m_out->write(m_buffer.data(), m_used);
+        m_out->flush();
+        if (!*m_out)
+            throw runtime_error("Export write failed");
+    }
+    else
+        return;
+    m_flushed += m_used;
+    m_used = 0;
+}
+
+// Returns the number of bytes written so far, flushed or not
+size_t PostSink::size() const {
+    return m_flushed + m_used;
+}
 
-    // Recursively clear left and right subtrees (post-order traversal for deletion)
-    if (node->m_left)
-        node->m_left = clearQueue(node->m_left);
+// Makes room for length more bytes: a sink with a destination flushes, an
+// in-memory sink (or a write larger than the whole buffer) grows the buffer
+void PostSink::makeRoom(size_t length) {
+    flush();
+    if (m_buffer.size() - m_used < length)
+        m_buffer.resize(max(m_buffer.size() * 2, m_used + length));
+}
 
-    if (node->m_right)
-        node->m_right = clearQueue(node->m_right);
+// Helper functions implementation
 
-    delete node; // Delete the current node
-    node = nullptr; // Set pointer to null after deletion
-    return node;
+// Deletes all nodes in a heap tree. For a large queue the left subtrees along
+// the top of the right spine are cleared on their own threads; the rest of the
+// tree is deleted iteratively, so no depth of tree can overflow the stack
+Post* SQueue::clearQueue(Post* node, int depth){
+    vector<thread> forks;
+    while (node && forkAt(node, depth)){
+        Post* left = node->m_left;
+        forks.push_back(thread([this, left, depth]{ clearQueue(left, depth + 1); }));
+        Post* right = node->m_right;
+        delete node; // Delete the current node
+        node = right;
+        depth++;
+    }
+    deleteTree(node);
+    for (size_t i = 0; i < forks.size(); i++)
+        forks[i].join();
+    return nullptr;
 }
 
-// Deep copy function for a heap tree
-Post* SQueue::copyTree(Post* node){
-    if(!node) return nullptr; // Base case: if node is null, return null
+// Deletes a tree in O(1) extra memory: a node with a left child is rotated so
+// that the child becomes its parent, and a node without one is deleted before
+// going on to its right child
+void SQueue::deleteTree(Post* node){
+    while (node){
+        Post* left = node->m_left;
+        if (left){
+            node->m_left = left->m_right;
+            left->m_right = node;
+            node = left;
+        }
+        else{
+            Post* right = node->m_right;
+            delete node;
+            node = right;
+        }
+    }
+}
 
-    // Create a new Post node with copied data
-    Post* newNode = new Post(node->m_postID, node->m_likes, node->m_connectLevel, node->m_postTime, node->m_interestLevel);
-    newNode->m_npl = node->m_npl; // Copy NPL (Null Path Length)
-    newNode->m_left = copyTree(node->m_left); // Recursively copy left subtree
-    newNode->m_right = copyTree(node->m_right); // Recursively copy right subtree
+// Deep copy function for a heap tree, without recursion: the nodes still to copy
+// wait on an explicit stack with the link their copy goes to, since a pairing
+// heap can have long chains of left children as well as long sibling lists
+Post* SQueue::copyTree(Post* node, int depth){
+    // A node still to copy, the link its copy goes to and its depth
+    struct Pending{
+        Post* m_node;
+        Post** m_link;
+        int m_depth;
+    };
+    Post* copy = nullptr; // Root of the copied subtree
+    vector<Pending> stack;
+    vector<thread> forks;
+    if (node)
+        stack.push_back({node, &copy, depth});
+    while (!stack.empty()){
+        Pending next = stack.back();
+        stack.pop_back();
+        Post* source = next.m_node;
+        // Create a new Post node with copied data
+        Post* newNode = new Post(source->m_payload);
+        newNode->m_npl = source->m_npl; // Copy NPL (Null Path Length)
+        newNode->m_key = source->m_key; // Copy the cached key and insertion epoch
+        newNode->m_epoch = source->m_epoch;
+        *next.m_link = newNode;
+        // The left subtree is copied on its own thread for a large queue
+        Post* left = source->m_left;
+        int childDepth = next.m_depth + 1;
+        if (left && forkAt(source, next.m_depth))
+            forks.push_back(thread([this, newNode, left, childDepth]{ newNode->m_left = copyTree(left, childDepth); }));
+        else if (left)
+            stack.push_back({left, &newNode->m_left, childDepth});
+        if (source->m_right)
+            stack.push_back({source->m_right, &newNode->m_right, childDepth});
+    }
+    for (size_t i = 0; i < forks.size(); i++)
+        forks[i].join();
+    return copy; // Return the root of the copied subtree
+}
 
-    return newNode; // Return the new node (root of the copied subtree)
+// Subtrees are forked only in large queues, only near the root (see setThreads)
+// and only where both children exist
+bool SQueue::forkAt(const Post* node, int depth) const{
+    return depth < m_forkDepth && m_size >= PARALLELSIZE && node->m_left && node->m_right;
 }
 
 // Merges two skew heaps, maintaining the heap property
@@ -270,15 +1544,16 @@ Post* SQueue::mergeSkew(Post * root, Post* node){
     // Handle null roots
     if (!root) return node;
     if(!node) return root;
+    m_steps++;
 
     // Ensure root is the new root based on heap type (MINHEAP or MAXHEAP)
     if (m_heapType == MINHEAP){
-        if ( m_priorFunc(*root) > m_priorFunc(*node)) 
+        if ( root->m_key > node->m_key) 
             swap(root, node); // Swap if root's priority is greater than node's (for MINHEAP)
     }
     else if (m_heapType == MAXHEAP) // For MAXHEAP
     {
-        if (m_priorFunc(*root) < m_priorFunc(*node))
+        if (root->m_key < node->m_key)
             swap(root, node); // Swap if root's priority is smaller than node's (for MAXHEAP)
     }
 
@@ -293,6 +1568,243 @@ Post* SQueue::mergeSkew(Post * root, Post* node){
     return root; // Return the new root
 }
 
+// Merges two heaps using the merge function of the current structure
+Post* SQueue::merge(Post* root, Post* node){
+    if (m_structure == LEFTIST)
+        return mergeLeftist(root, node);
+    if (m_structure == PAIRING)
+        return mergePairing(root, node);
+    return mergeSkew(root, node);
+}
+
+// Merges two pairing heaps: the losing root becomes the first child of the winning root
+Post* SQueue::mergePairing(Post* root, Post* node){
+    // Handle null roots
+    if (!root) return node;
+    if (!node) return root;
+    m_steps++;
+
+    // Ensure root is the new root based on heap type (MINHEAP or MAXHEAP)
+    if (m_heapType == MINHEAP){
+        if (root->m_key > node->m_key)
+            swap(root, node);
+    }
+    else if (m_heapType == MAXHEAP){
+        if (root->m_key < node->m_key)
+            swap(root, node);
+    }
+
+    // Link node in front of root's children; both arguments are roots, so their sibling links are free
+    node->m_right = root->m_left;
+    root->m_left = node;
+    return root;
+}
+
+// Two-pass pairing: merges the siblings in pairs from left to right, then merges
+// the resulting heaps from right to left into a single pairing heap
+Post* SQueue::pairChildren(Post* first){
+    if (!first) return nullptr;
+
+    // First pass: pair up neighbours, collecting the results in reverse order
+    Post* paired = nullptr;
+    while (first){
+        Post* node1 = first;
+        Post* node2 = first->m_right;
+        if (!node2){ // An odd sibling is carried over unpaired
+            node1->m_right = paired;
+            paired = node1;
+            break;
+        }
+        first = node2->m_right;
+        node1->m_right = nullptr;
+        node2->m_right = nullptr;
+        Post* pair = mergePairing(node1, node2);
+        pair->m_right = paired;
+        paired = pair;
+    }
+
+    // Second pass: merge the pairs from right to left
+    Post* root = paired;
+    paired = paired->m_right;
+    root->m_right = nullptr;
+    while (paired){
+        Post* next = paired->m_right;
+        paired->m_right = nullptr;
+        root = mergePairing(root, paired);
+        paired = next;
+    }
+    return root;
+}
+
+// Merges the lazily melded roots into m_heap; roots are merged pairwise in
+// rounds so that every root takes part in O(log k) merges for k pending roots
+void SQueue::consolidate(){
+    if (m_pending.empty()) return; // Nothing was melded lazily
+
+    if (m_heap != nullptr)
+        m_pending.push_back(m_heap);
+    m_heap = mergeRounds(m_pending);
+}
+
+// Merges heaps pairwise in rounds until one is left, and empties roots
+Post* SQueue::mergeRounds(vector<Post*>& roots){
+    if (roots.empty()) return nullptr;
+    while (roots.size() > 1){
+        size_t count = 0;
+        for (size_t i = 0; i + 1 < roots.size(); i += 2)
+            roots[count++] = merge(roots[i], roots[i + 1]);
+        if (roots.size() % 2 == 1) // An odd root waits for the next round
+            roots[count++] = roots.back();
+        roots.resize(count);
+    }
+    Post* root = roots[0];
+    roots.clear();
+    return root;
+}
+
+// Builds the ordering key of a priority inserted at the given epoch. Without decay
+// it is the priority itself. With decay it is log2(priority) * halfLife plus or
+// minus the insertion epoch (in fixed point): decayed priorities compare the same
+// way at every later epoch, because aging multiplies all of them by the same factor.
+// A negative priority (from a model or a function that allows them) has no
+// logarithm: it is keyed like a priority of 1, below every positive priority
+long long SQueue::makeKey(int priority, int epoch) const{
+    if (m_halfLife == 0)
+        return priority;
+    long long logKey = llround(log2((double)max(priority, 1)) * DECAYSCALE) * m_halfLife;
+    long long timeKey = (long long)epoch * DECAYSCALE;
+    return m_heapType == MAXHEAP ? logKey + timeKey : logKey - timeKey;
+}
+
+// Recomputes the cached key of every node of a tree; the nodes are gathered
+// with an explicit stack and their priorities evaluated in batches
+void SQueue::refreshKeys(Post* root){
+    vector<Post*> nodes;
+    if (root) nodes.push_back(root);
+    for (size_t next = 0; next < nodes.size(); next++){
+        if (nodes[next]->m_left) nodes.push_back(nodes[next]->m_left);
+        if (nodes[next]->m_right) nodes.push_back(nodes[next]->m_right);
+    }
+
+    // Every thread rekeys its own contiguous range of nodes
+    int threads = (m_threads > 1 && (int)nodes.size() >= PARALLELSIZE) ? m_threads : 1;
+    size_t range = (nodes.size() + threads - 1) / threads;
+    vector<thread> forks;
+    for (int t = 0; t < threads; t++){
+        size_t first = t * range;
+        size_t last = min(nodes.size(), first + range);
+        forks.push_back(forkTask(threads > 1, [this, &nodes, first, last]{
+            int priorities[PRIORITYBATCH];
+            for (size_t start = first; start < last; start += PRIORITYBATCH){
+                int count = (int)min((size_t)PRIORITYBATCH, last - start);
+                evaluate(&nodes[start], count, priorities);
+                for (int i = 0; i < count; i++)
+                    nodes[start + i]->m_key = makeKey(priorities[i], nodes[start + i]->m_epoch);
+            }
+        }));
+    }
+    for (size_t i = 0; i < forks.size(); i++)
+        if (forks[i].joinable())
+            forks[i].join();
+}
+
+// Returns the priority of a post from the linear model or the priority function
+int SQueue::priority(const Post& post) const{
+    return m_linear ? m_model.priority(post) : m_priorFunc(post);
+}
+
+// Evaluates the priorities of count posts. A linear model gathers the fields
+// into struct-of-arrays chunks for its batch kernel; a priority function is
+// called once per post
+void SQueue::evaluate(const Post* const posts[], int count, int priorities[]) const{
+    if (!m_linear){
+        for (int i = 0; i < count; i++)
+            priorities[i] = m_priorFunc(*posts[i]);
+        return;
+    }
+
+    int likes[PRIORITYBATCH], connectLevels[PRIORITYBATCH], postTimes[PRIORITYBATCH], interestLevels[PRIORITYBATCH];
+    for (int start = 0; start < count; start += PRIORITYBATCH){
+        int chunk = min(PRIORITYBATCH, count - start);
+        for (int i = 0; i < chunk; i++){
+            const Post* post = posts[start + i];
+            likes[i] = post->getNumLikes();
+            connectLevels[i] = post->getConnectLevel();
+            postTimes[i] = post->getPostTime();
+            interestLevels[i] = post->getInterestLevel();
+        }
+        m_model.evaluate(likes, connectLevels, postTimes, interestLevels, priorities + start, chunk);
+    }
+}
+
+// Rebuilds the heap of the current structure after the keys changed
+void SQueue::rebuild(){
+    m_heap = rebuildHeap(m_heap);
+}
+
+// Returns the radix heap bucket of a priority: 0 if it equals the last extracted
+// priority, otherwise one plus the index of the highest bit where they differ
+int SQueue::radixBucket(int key) const{
+    unsigned int diff = (unsigned int)key ^ (unsigned int)m_radixLast;
+    if (diff == 0) return 0;
+    return 32 - __builtin_clz(diff);
+}
+
+// Files a detached node under its priority in the radix heap
+void SQueue::radixPush(Post* node, int key){
+    if (m_buckets.empty())
+        m_buckets.resize(RADIXBUCKETS);
+    m_buckets[radixBucket(key)].push_back(make_pair(key, node));
+    m_steps++;
+}
+
+// Makes bucket 0 non-empty: the first non-empty bucket is scanned for its minimum,
+// which becomes the new bound, and its entries are redistributed into lower buckets.
+// Each entry can only move down, which gives amortized O(log C) per operation
+void SQueue::radixSettle(){
+    if (!m_buckets[0].empty()) return;
+
+    int bucket = 1;
+    while (m_buckets[bucket].empty())
+        bucket++;
+
+    vector< pair<int, Post*> >& entries = m_buckets[bucket];
+    int minKey = entries[0].first;
+    for (size_t i = 1; i < entries.size(); i++)
+        if (entries[i].first < minKey)
+            minKey = entries[i].first;
+
+    m_radixLast = minKey;
+    m_steps += entries.size();
+    for (size_t i = 0; i < entries.size(); i++)
+        m_buckets[radixBucket(entries[i].first)].push_back(entries[i]);
+    entries.clear();
+}
+
+// Detaches every node of a tree into nodes, using an explicit stack
+void SQueue::collectNodes(Post* root, vector<Post*>& nodes){
+    if (!root) return;
+    size_t next = nodes.size();
+    nodes.push_back(root);
+    while (next < nodes.size()){
+        Post* node = nodes[next++];
+        if (node->m_left) nodes.push_back(node->m_left);
+        if (node->m_right) nodes.push_back(node->m_right);
+        node->m_left = nullptr;
+        node->m_right = nullptr;
+        node->m_npl = 0;
+    }
+}
+
+// Moves every node of the radix heap into nodes and empties the buckets
+void SQueue::collectRadix(vector<Post*>& nodes){
+    for (size_t i = 0; i < m_buckets.size(); i++){
+        for (size_t j = 0; j < m_buckets[i].size(); j++)
+            nodes.push_back(m_buckets[i][j].second);
+        m_buckets[i].clear();
+    }
+}
+
 // Swaps two Post pointers
 void SQueue::swap(Post* &node1, Post* &node2){
     Post* temp = node1;
@@ -305,16 +1817,17 @@ Post* SQueue::mergeLeftist( Post* root, Post* node){
     // Handle null roots
     if (!root) return node;
     if(!node) return root;
+    m_steps++;
 
     // Ensure 'root' is the new root based on heap type (MINHEAP or MAXHEAP)
     if (m_heapType == MINHEAP)
     {
-        if (m_priorFunc(*root) > m_priorFunc(*node))
+        if (root->m_key > node->m_key)
             swap (root, node); // Swap if root's priority is greater than node's (for MINHEAP)
     }
     else if (m_heapType == MAXHEAP) // For MAXHEAP
     {
-        if (m_priorFunc(*root) < m_priorFunc(*node))
+        if (root->m_key < node->m_key)
             swap(root, node); // Swap if root's priority is smaller than node's (for MAXHEAP)
     }
 
@@ -341,38 +1854,97 @@ Post* SQueue::mergeLeftist( Post* root, Post* node){
     return root; // Return the new root
 }
 
-// Performs a preorder traversal and prints each node's information
-void SQueue::preorderPrint(Post* root)const{
-    if (!root) return; // Base case: if node is null, return
-    // Print current node's priority, Post ID, likes, and connect level
-    cout << "[" << m_priorFunc(*root) << "] Post#: " << root->m_postID << ", likes#: " << root->m_likes << ", connect level: " << root->m_connectLevel << endl;
-        
-    preorderPrint(root->m_left); // Recursively print left child
-    preorderPrint(root->m_right); // Recursively print right child
+// Performs an iterative preorder traversal and exports each node's information
+void SQueue::exportTree(Post* root, PostSink& sink, EXPORTFORMAT format, bool& first) const{
+    vector<Post*> stack;
+    if (root != nullptr)
+        stack.push_back(root);
+    while (!stack.empty()){
+        Post* node = stack.back();
+        stack.pop_back();
+        int nodePriority = priority(*node);
+        char* out = sink.reserve(EXPORTRECORD);
+        if (format == TEXT){
+            // Priority, Post ID, likes, and connect level, as printPostsQueue has always shown them
+            out = appendText(out, "[");
+            out = appendInt(out, nodePriority);
+            out = appendText(out, "] Post#: ");
+            out = appendInt(out, node->getPostID());
+            out = appendText(out, ", likes#: ");
+            out = appendInt(out, node->getNumLikes());
+            out = appendText(out, ", connect level: ");
+            out = appendInt(out, node->getConnectLevel());
+            out = appendText(out, "\n");
+        }
+        else if (format == JSON){
+            if (!first)
+                out = appendText(out, ",");
+            out = appendText(out, "\n{\"priority\":");
+            out = appendInt(out, nodePriority);
+            out = appendText(out, ",\"id\":");
+            out = appendInt(out, node->getPostID());
+            out = appendText(out, ",\"likes\":");
+            out = appendInt(out, node->getNumLikes());
+            out = appendText(out, ",\"connectLevel\":");
+            out = appendInt(out, node->getConnectLevel());
+            out = appendText(out, ",\"postTime\":");
+            out = appendInt(out, node->getPostTime());
+            out = appendText(out, ",\"interestLevel\":");
+            out = appendInt(out, node->getInterestLevel());
+            out = appendText(out, "}");
+        }
+        else{
+            int record[6] = {nodePriority, node->getPostID(), node->getNumLikes(), node->getConnectLevel(),
+                             node->getPostTime(), node->getInterestLevel()};
+            memcpy(out, record, sizeof(record));
+            out += sizeof(record);
+        }
+        sink.commit(out);
+        first = false;
+        if (node->m_right != nullptr) // Right child (or next sibling) after the left subtree
+            stack.push_back(node->m_right);
+        if (node->m_left != nullptr)
+            stack.push_back(node->m_left);
+    }
 }
 
 // Functions to change heap structure
 
-// Converts a heap from Skew to Leftist structure (updates NPLs and ensures leftist property)
-Post* SQueue::switchToLeftist(Post* root){
+// Converts a heap from Skew to Leftist structure (updates NPLs and ensures leftist property).
+// The top levels of a large queue are split across threads; below them the nodes
+// are listed top-down and fixed in reverse, so children come before their parent
+Post* SQueue::switchToLeftist(Post* root, int depth){
     if (!root) return nullptr; // Base case
 
-    // Recursively convert left and right subtrees
-    root->m_left = switchToLeftist(root->m_left);
-    root->m_right = switchToLeftist(root->m_right);
+    if (forkAt(root, depth)){
+        thread left([this, root, depth]{ root->m_left = switchToLeftist(root->m_left, depth + 1); });
+        root->m_right = switchToLeftist(root->m_right, depth + 1);
+        left.join();
+        fixLeftist(root);
+        return root;
+    }
+    vector<Post*> nodes(1, root);
+    for (size_t next = 0; next < nodes.size(); next++){
+        if (nodes[next]->m_left) nodes.push_back(nodes[next]->m_left);
+        if (nodes[next]->m_right) nodes.push_back(nodes[next]->m_right);
+    }
+    for (size_t i = nodes.size(); i-- > 0;)
+        fixLeftist(nodes[i]);
+    return root; // Return the restructured root
+}
 
+// Restores the leftist property of a node whose subtrees are already leftist
+void SQueue::fixLeftist(Post* root){
     // Get NPL of left and right subtrees (or -1 if null)
     int rightNpl = (root->m_right ? root->m_right->m_npl : -1) + 1;
     int leftNpl = (root->m_left ? root->m_left->m_npl : -1) + 1;
-    
+
     // Swap children if the left child's NPL is smaller than the right child's NPL
     if (leftNpl < rightNpl)
         swap(root->m_left, root->m_right);
 
     // Update the NPL of the current root based on its (possibly new) right child
     root->m_npl = (root->m_right ? root->m_right->m_npl : -1) + 1;
-
-    return root; // Return the restructured root
 }
 
 // Converts a heap from Leftist to Skew structure (swaps children for skew property)
@@ -385,39 +1957,230 @@ Post* SQueue::switchToSkew(Post* root){
     return root; // Return the restructured root
 }
 
-// Rebuilds the heap structure after a priority function or heap type change
-// This function essentially re-heaps the tree to satisfy the new heap property
+// Converts a Skew or Leftist heap to a pairing heap; the two children of every node
+// become its child list, which keeps the heap order without any comparisons.
+// Nodes wait on an explicit stack with their future next sibling, so their own
+// links are read before they are overwritten
+Post* SQueue::switchToPairing(Post* root){
+    vector< pair<Post*, Post*> > stack; // (node, its next sibling in the child list)
+    if (root)
+        stack.push_back(make_pair(root, (Post*)nullptr));
+    while (!stack.empty()){
+        Post* node = stack.back().first;
+        Post* sibling = stack.back().second;
+        stack.pop_back();
+        Post* left = node->m_left;
+        Post* right = node->m_right;
+        if (left) // The child list starts at the first non-empty subtree
+            stack.push_back(make_pair(left, right));
+        if (right)
+            stack.push_back(make_pair(right, (Post*)nullptr));
+        node->m_left = left ? left : right;
+        node->m_right = sibling;
+        node->m_npl = 0;
+    }
+    return root;
+}
+
+// Converts a pairing heap to the structure stored in m_structure: the nodes are
+// detached and merged pairwise in rounds, in linear time and without recursion
+Post* SQueue::switchFromPairing(Post* root){
+    vector<Post*> nodes;
+    collectNodes(root, nodes);
+    return mergeRounds(nodes);
+}
+
+// Rebuilds the heap structure after a priority function or heap type change:
+// the nodes are detached and merged pairwise in rounds, which takes linear time
+// for every structure and any shape of tree, and needs no recursion
 Post* SQueue::rebuildHeap(Post* root){
-    if (!root) return nullptr; // Base case
+    vector<Post*> nodes;
+    collectNodes(root, nodes);
+    return mergeRounds(nodes);
+}
 
-    // Recursively rebuild left and right subtrees
-    root->m_left = rebuildHeap(root->m_left);
-    root->m_right = rebuildHeap(root->m_right);
+atomic<TraceRecorder*> TraceRecorder::s_active(nullptr);
+atomic<int> TraceRecorder::s_calls(0);
+
+// Counts the call as in use, then checks that the recorder is still active. The
+// destructor clears s_active before it waits for s_calls, so (both sequentially
+// consistent) either the check sees the recorder gone or the destructor sees the call
+void TraceRecorder::Call::pin() {
+    s_calls.fetch_add(1);
+    m_recorder = s_active.load();
+    if (m_recorder == nullptr)
+        s_calls.fetch_sub(1, memory_order_release);
+}
 
-    Post* leader = root; // Start by assuming current root is the leader (min/max)
-    // Compare current root with left child to find the true leader
-    if (root->m_left){
-        if ((m_heapType == MINHEAP && m_priorFunc(*root->m_left) < m_priorFunc(*leader))
-            || (m_heapType == MAXHEAP && m_priorFunc(*root->m_left) > m_priorFunc(*leader))){
-                leader = root->m_left;
-            }
+// Creates the trace file, writes its header and makes this the active recorder
+TraceRecorder::TraceRecorder(const string& path) {
+    m_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (m_fd < 0)
+        throw runtime_error("Cannot create trace " + path + ": " + string(strerror(errno)));
+    m_sink = new PostSink(m_fd);
+    m_sink->write(TRACEMAGIC, sizeof(TRACEMAGIC));
+    m_nextQueue = 0;
+    m_records = 0;
+    TraceRecorder* none = nullptr;
+    if (!s_active.compare_exchange_strong(none, this)){
+        delete m_sink;
+        close(m_fd);
+        throw runtime_error("A trace is already being recorded");
     }
+}
 
-    // Compare current leader with right child to find the overall leader
-    if (root->m_right) {
-        if ((m_heapType == MINHEAP && m_priorFunc(*root->m_right) < m_priorFunc(*leader)) ||
-            (m_heapType == MAXHEAP && m_priorFunc(*root->m_right) > m_priorFunc(*leader))) {
-            leader = root->m_right;
-        }   
-    }
+// Stops recording, waits for the calls that still hold the recorder, then
+// flushes and closes the trace
+TraceRecorder::~TraceRecorder() {
+    s_active.store(nullptr);
+    while (s_calls.load() != 0)
+        this_thread::yield();
+    delete m_sink;
+    close(m_fd);
+}
+
+long long TraceRecorder::numRecords() const {
+    lock_guard<mutex> guard(m_lock);
+    return m_records;
+}
+
+const vector<prifn_t>& TraceRecorder::getFunctions() const {
+    return m_functions;
+}
+
+// Records a new queue with its configuration
+void TraceRecorder::recordCreate(const SQueue& queue) {
+    lock_guard<mutex> guard(m_lock);
+    queueNumber(queue);
+}
+
+// Records a copy construction (TRACECOPY) or an assignment (TRACEASSIGN) from source
+void TraceRecorder::recordCopy(const SQueue& queue, const SQueue& source, TRACEOP op) {
+    lock_guard<mutex> guard(m_lock);
+    unsigned sourceNumber = queueNumber(source);
+    if (op == TRACECOPY)
+        m_queues[&queue] = m_nextQueue++;
+    begin(queue, op);
+    writeVarint(sourceNumber);
+}
 
-    // If a child is the leader, swap with the current root and recursively rebuild that subtree
-    if(leader != root){
-        Post temp = *root; // Temporarily store root's data
-        *root = *leader; // Copy leader's data to root
-        *leader = temp; // Copy root's original data to leader's position
-        rebuildHeap(leader); // Recursively rebuild the subtree where the swap occurred
+// Records a call with at most one argument (a payload, a structure, a half-life,
+// epochs, a number of threads or a flag)
+void TraceRecorder::record(const SQueue& queue, TRACEOP op, uint64_t argument) {
+    lock_guard<mutex> guard(m_lock);
+    begin(queue, op);
+    if (op != TRACEPOP)
+        writeVarint(argument);
+}
+
+// Records a bulk insert with all its posts
+void TraceRecorder::recordInserts(const SQueue& queue, const Post posts[], int count) {
+    lock_guard<mutex> guard(m_lock);
+    begin(queue, TRACEINSERTS);
+    writeVarint(count);
+    for (int i = 0; i < count; i++)
+        writeVarint(posts[i].getPayload());
+}
+
+void TraceRecorder::recordMerge(const SQueue& queue, const SQueue& rhs, bool convert) {
+    lock_guard<mutex> guard(m_lock);
+    unsigned rhsNumber = queueNumber(rhs);
+    begin(queue, convert ? TRACEMERGECONVERT : TRACEMERGE);
+    writeVarint(rhsNumber);
+}
+
+void TraceRecorder::recordPriorityFn(const SQueue& queue, prifn_t priFn, HEAPTYPE heapType) {
+    lock_guard<mutex> guard(m_lock);
+    begin(queue, TRACEPRIORITYFN);
+    writeVarint(functionNumber(priFn));
+    writeVarint(heapType);
+}
+
+void TraceRecorder::recordPriorityModel(const SQueue& queue, const LinearPriority& model, HEAPTYPE heapType) {
+    lock_guard<mutex> guard(m_lock);
+    begin(queue, TRACEPRIORITYMODEL);
+    writeModel(model, heapType);
+}
+
+// Records a clear or the destruction of a queue already in the trace; a queue
+// that was never used while recording has nothing to remove
+void TraceRecorder::recordRemoval(const SQueue& queue, TRACEOP op) {
+    lock_guard<mutex> guard(m_lock);
+    unordered_map<const SQueue*, unsigned>::iterator found = m_queues.find(&queue);
+    if (found == m_queues.end())
+        return;
+    begin(queue, op);
+    if (op == TRACEDESTROY)
+        m_queues.erase(found); // The address may be reused by a new queue
+}
+
+// Returns the number of a queue; a queue seen for the first time is recorded
+// with a TRACECREATE of its current configuration, followed by a
+// TRACEPRIORITYMODEL if it has a linear model (its function is then nullptr).
+// Called with the lock held
+unsigned TraceRecorder::queueNumber(const SQueue& queue) {
+    unordered_map<const SQueue*, unsigned>::iterator found = m_queues.find(&queue);
+    if (found != m_queues.end())
+        return found->second;
+    unsigned number = m_nextQueue++;
+    m_queues[&queue] = number;
+    unsigned function = functionNumber(queue.m_priorFunc);
+    char* out = m_sink->reserve(1);
+    *out = (char)TRACECREATE;
+    m_sink->commit(out + 1);
+    writeVarint(number);
+    writeVarint(function);
+    writeVarint(queue.m_heapType);
+    writeVarint(queue.m_adaptive ? AUTO : queue.m_structure);
+    writeVarint(queue.m_halfLife);
+    m_records++;
+    if (queue.m_linear){
+        out = m_sink->reserve(1);
+        *out = (char)TRACEPRIORITYMODEL;
+        m_sink->commit(out + 1);
+        writeVarint(number);
+        writeModel(queue.m_model, queue.m_heapType);
+        m_records++;
     }
+    return number;
+}
 
-    return root; // Return the (potentially new) root of the subtree
-}
\ No newline at end of file
+// Returns the number of a priority function, numbering new ones in order
+unsigned TraceRecorder::functionNumber(prifn_t priFn) {
+    for (size_t i = 0; i < m_functions.size(); i++)
+        if (m_functions[i] == priFn)
+            return (unsigned)i;
+    m_functions.push_back(priFn);
+    return (unsigned)m_functions.size() - 1;
+}
+
+// Starts a record: the operation and the queue's number. Called with the lock held
+void TraceRecorder::begin(const SQueue& queue, TRACEOP op) {
+    unsigned number = queueNumber(queue);
+    char* out = m_sink->reserve(1);
+    *out = (char)op;
+    m_sink->commit(out + 1);
+    writeVarint(number);
+    m_records++;
+}
+
+// Writes the heap type, then the weights, bias and range of a model, zigzag
+// encoded so that small negative values stay short
+void TraceRecorder::writeModel(const LinearPriority& model, HEAPTYPE heapType) {
+    int values[7] = {model.m_likesWeight, model.m_connectWeight, model.m_timeWeight, model.m_interestWeight,
+                     model.m_bias, model.m_minValue, model.m_maxValue};
+    writeVarint(heapType);
+    for (int i = 0; i < 7; i++)
+        writeVarint(((uint32_t)values[i] << 1) ^ (uint32_t)(values[i] >> 31));
+}
+
+// Writes 7 bits per byte, low bits first; the high bit marks a following byte
+void TraceRecorder::writeVarint(uint64_t value) {
+    char* out = m_sink->reserve(10);
+    while (value >= 0x80){
+        *out++ = (char)(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (char)value;
+    m_sink->commit(out);
+}
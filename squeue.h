@@ -3,6 +3,12 @@
 #include <stdexcept>
 #include <iostream>
 #include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
 using namespace std;
 class Tester;   // forward declaration (for testing purposes)
 class SQueue;   // forward declaration
@@ -18,110 +24,433 @@ const int MINCONLEVEL = 1;//highest priority
 const int MAXCONLEVEL = 5;//lowest priority
 const int MINTIME = 1;//highest priority
 const int MAXTIME = 50;//lowest priority
+// Bit layout of a packed Post: the bounds above fit the five fields in 42 bits
+const int IDBITS = 20;          // post ID, up to MAXPOSTID
+const int LIKESBITS = 9;        // likes, up to MAXLIKES
+const int CONLEVELBITS = 3;     // connect level, up to MAXCONLEVEL
+const int TIMEBITS = 6;         // post time, up to MAXTIME
+const int INTERESTBITS = 4;     // interest level, up to MAXINTERESTLEVEL
+const int LIKESSHIFT = IDBITS;
+const int CONLEVELSHIFT = LIKESSHIFT + LIKESBITS;
+const int TIMESHIFT = CONLEVELSHIFT + CONLEVELBITS;
+const int INTERESTSHIFT = TIMESHIFT + TIMEBITS;
 enum HEAPTYPE {MINHEAP, MAXHEAP};
-enum STRUCTURE {SKEW, LEFTIST};
+enum STRUCTURE {SKEW, LEFTIST, PAIRING, RADIX, AUTO};// RADIX: monotone MINHEAP only; AUTO: picked at runtime
+enum EXPORTFORMAT {TEXT, JSON, BINARY};
+// Calls recorded in a trace, see TraceRecorder
+enum TRACEOP {TRACECREATE = 1, TRACECOPY, TRACEASSIGN, TRACEDESTROY, TRACEINSERT, TRACEINSERTS, TRACEPOP,
+              TRACEMERGE, TRACECLEAR, TRACEPRIORITYFN, TRACESTRUCTURE, TRACEDECAY, TRACEEPOCH, TRACEMERGECONVERT,
+              TRACEPRIORITYMODEL, TRACELAZYMERGE, TRACETHREADS, TRACEDEFERREDCLEAR};
+const char TRACEMAGIC[8] = {'S', 'Q', 'T', 'R', 'A', 'C', 'E', '1'}; // first bytes of a trace file
+const size_t SINKCAPACITY = 1 << 20; // default buffer size of a PostSink
 
 // Priority function pointer type
 typedef int (*prifn_t)(const Post&);
 
+// Declarative priority: a weighted sum of the Post fields plus a bias. Like the
+// priority functions, a sum outside [minValue, maxValue] evaluates to 0 (invalid).
+// Unlike them it can be evaluated over whole batches of posts with SIMD kernels
+class LinearPriority{
+    public:
+    LinearPriority(){
+        m_likesWeight = 0;m_connectWeight = 0;m_timeWeight = 0;
+        m_interestWeight = 0;m_bias = 0;
+        m_minValue = 1;m_maxValue = 0; // empty range: every post is invalid
+    }
+    LinearPriority(int likesWeight, int connectWeight, int timeWeight, int interestWeight,
+                   int bias, int minValue, int maxValue){
+        m_likesWeight = likesWeight;m_connectWeight = connectWeight;m_timeWeight = timeWeight;
+        m_interestWeight = interestWeight;m_bias = bias;
+        m_minValue = minValue;m_maxValue = maxValue;
+    }
+    int priority(const Post& post) const; // Scalar evaluation of one post
+    // Evaluates count posts given as struct-of-arrays; uses AVX2 or SSE4.1 when
+    // the build enables them (e.g. -mavx2) and a scalar loop otherwise
+    void evaluate(const int likes[], const int connectLevels[], const int postTimes[],
+                  const int interestLevels[], int priorities[], int count) const;
+    bool operator==(const LinearPriority& rhs) const;
+
+    private:
+    friend class TraceRecorder;
+    int m_likesWeight;
+    int m_connectWeight;
+    int m_timeWeight;
+    int m_interestWeight;
+    int m_bias;
+    int m_minValue;         // lowest valid priority
+    int m_maxValue;         // highest valid priority
+};
+
+// Buffered output of exports: bytes are gathered in one preallocated buffer and
+// handed on in large blocks, to a file descriptor or an ostream. A sink without a
+// destination keeps everything in memory and grows its buffer instead
+class PostSink{
+    public:
+    PostSink(size_t capacity = SINKCAPACITY);
+    PostSink(int fd, size_t capacity = SINKCAPACITY);
+    PostSink(ostream& out, size_t capacity = SINKCAPACITY);
+    ~PostSink(); // Flushes what is left
+    PostSink(const PostSink& rhs) = delete; // the buffer belongs to one destination
+    PostSink& operator=(const PostSink& rhs) = delete;
+    void write(const char* data, size_t length);
+    void write(const string& text) {write(text.data(), text.size());}
+    void writeInt(int value); // Decimal text
+    void writeRaw(int value); // Native 4 byte binary
+    void flush(); // Hands the buffer to the destination
+    size_t size() const; // Bytes written so far
+    const char* data() const {return m_buffer.data();} // In-memory contents
+    // Room for at least length more bytes, flushing or growing the buffer if needed
+    char* reserve(size_t length){
+        if (m_buffer.size() - m_used < length) makeRoom(length);
+        return m_buffer.data() + m_used;
+    }
+    void commit(char* end) {m_used = end - m_buffer.data();} // Ends a write into reserve()
+
+    private:
+    vector<char> m_buffer;
+    size_t m_used;          // bytes in the buffer
+    size_t m_flushed;       // bytes already handed to the destination
+    int m_fd;               // destination file descriptor, -1 if none
+    ostream* m_out;         // destination stream, nullptr if none
+
+    void makeRoom(size_t length);
+};
+
+// Records the calls made on every SQueue of the process (creation, copies, inserts,
+// pops, merges and every configuration call) to a compact binary
+// trace while it exists; TraceReplayer (workload.h) replays it. A record is an
+// operation byte, the queue's number and varint arguments, e.g. 2 bytes for a pop
+// and up to 8 for an insert. One recorder is active at a time, and calls from
+// several threads are serialized; its destructor waits for the calls in flight.
+// Priority functions are recorded by number, in the order they are first seen;
+// LinearPriority models are recorded with their weights. A queue created before
+// recording started joins the trace empty, configured as when first used
+class TraceRecorder{
+    public:
+    TraceRecorder(const string& path); // Creates the trace file and starts recording
+    ~TraceRecorder(); // Stops recording and flushes the trace
+    TraceRecorder(const TraceRecorder& rhs) = delete; // one recorder per trace file
+    TraceRecorder& operator=(const TraceRecorder& rhs) = delete;
+    long long numRecords() const;
+    // Priority functions by their number in the trace; nullptr is the function of
+    // the queues created with a linear model
+    const vector<prifn_t>& getFunctions() const;
+
+    // The recorder in use for one call, empty when nothing is recorded. While it
+    // exists the recorder is counted as in use, so it is not torn down under the
+    // call; when nothing is recorded it costs a single load
+    class Call{
+        public:
+        Call() : m_recorder(s_active.load(memory_order_acquire)) {if (m_recorder != nullptr) pin();}
+        ~Call() {if (m_recorder != nullptr) s_calls.fetch_sub(1, memory_order_release);}
+        Call(const Call& rhs) = delete;
+        Call& operator=(const Call& rhs) = delete;
+        explicit operator bool() const {return m_recorder != nullptr;}
+        TraceRecorder* operator->() const {return m_recorder;}
+
+        private:
+        TraceRecorder* m_recorder;
+        void pin();
+    };
+
+    private:
+    friend class SQueue;
+    static atomic<TraceRecorder*> s_active;
+    static atomic<int> s_calls;     // Calls holding the active recorder
+    mutable mutex m_lock;
+    int m_fd;
+    PostSink* m_sink;
+    unordered_map<const SQueue*, unsigned> m_queues; // numbers of the queues seen so far
+    unsigned m_nextQueue;
+    vector<prifn_t> m_functions;
+    long long m_records;
+
+    // Called by SQueue
+    void recordCreate(const SQueue& queue);
+    void recordCopy(const SQueue& queue, const SQueue& source, TRACEOP op); // TRACECOPY or TRACEASSIGN
+    void record(const SQueue& queue, TRACEOP op, uint64_t argument = 0);
+    void recordInserts(const SQueue& queue, const Post posts[], int count);
+    void recordMerge(const SQueue& queue, const SQueue& rhs, bool convert);
+    void recordPriorityFn(const SQueue& queue, prifn_t priFn, HEAPTYPE heapType);
+    void recordPriorityModel(const SQueue& queue, const LinearPriority& model, HEAPTYPE heapType);
+    void recordRemoval(const SQueue& queue, TRACEOP op); // TRACECLEAR or TRACEDESTROY
+
+    unsigned queueNumber(const SQueue& queue);
+    unsigned functionNumber(prifn_t priFn);
+    void begin(const SQueue& queue, TRACEOP op);
+    void writeModel(const LinearPriority& model, HEAPTYPE heapType);
+    void writeVarint(uint64_t value);
+};
+
+// A structure change made by an AUTO queue, with the sampling window behind it
+struct StructureChange{
+    long long m_operation;  // operations the queue had counted when it changed
+    STRUCTURE m_from;
+    STRUCTURE m_to;
+    int m_inserts;          // operation mix of the window
+    int m_pops;
+    int m_merges;
+    double m_cost;          // estimated cost per operation of m_from, in merge steps
+    double m_newCost;       // and of m_to
+    bool m_forced;          // m_from could not carry out an operation (e.g. a RADIX contract break)
+};
+
 class Post{
     public:
     friend class Tester; // for testing purposes
     friend class SQueue;
     Post(){
-        m_postID = DEFAULTPOSTID;m_likes = MINLIKES;
-        m_connectLevel = MAXCONLEVEL;m_postTime = MAXTIME;
-        m_interestLevel = MININTERESTLEVEL;
+        m_payload = pack(DEFAULTPOSTID, MINLIKES, MAXCONLEVEL, MAXTIME, MININTERESTLEVEL);
         m_right = nullptr;
         m_left = nullptr;
         m_npl = 0;
+        m_key = 0;
+        m_epoch = 0;
     }
     Post(int ID, int likes, int connectLevel, int postTime, int interestLevel){
-        if (ID < MINPOSTID || ID > MAXPOSTID) m_postID = DEFAULTPOSTID;
-        else m_postID = ID;
-        if (likes < MINLIKES || likes > MAXLIKES) m_likes = MINLIKES;
-        else m_likes = likes;
-        if (connectLevel < MINCONLEVEL || connectLevel > MAXCONLEVEL) m_connectLevel = MAXCONLEVEL;
-        else m_connectLevel = connectLevel;
-        if (postTime < MINTIME || postTime > MAXTIME) m_postTime = MAXTIME;
-        else m_postTime = postTime;
-        if (interestLevel < MININTERESTLEVEL || interestLevel > MAXINTERESTLEVEL) m_interestLevel = MININTERESTLEVEL;
-        else m_interestLevel = interestLevel;
+        if (ID < MINPOSTID || ID > MAXPOSTID) ID = DEFAULTPOSTID;
+        if (likes < MINLIKES || likes > MAXLIKES) likes = MINLIKES;
+        if (connectLevel < MINCONLEVEL || connectLevel > MAXCONLEVEL) connectLevel = MAXCONLEVEL;
+        if (postTime < MINTIME || postTime > MAXTIME) postTime = MAXTIME;
+        if (interestLevel < MININTERESTLEVEL || interestLevel > MAXINTERESTLEVEL) interestLevel = MININTERESTLEVEL;
+        m_payload = pack(ID, likes, connectLevel, postTime, interestLevel);
         m_right = nullptr;
         m_left = nullptr;
         m_npl = 0;
+        m_key = 0;
+        m_epoch = 0;
     }
-    int getPostID() const {return m_postID;}
-    int getNumLikes() const {return m_likes;}
-    int getConnectLevel() const {return m_connectLevel;}
-    int getPostTime() const {return m_postTime;}
-    int getInterestLevel() const {return m_interestLevel;}
+    // A post from the payload of another one; the fields are validated again
+    explicit Post(uint64_t payload)
+        : Post(field(payload, 0, IDBITS), field(payload, LIKESSHIFT, LIKESBITS),
+               field(payload, CONLEVELSHIFT, CONLEVELBITS), field(payload, TIMESHIFT, TIMEBITS),
+               field(payload, INTERESTSHIFT, INTERESTBITS)) {}
+    int getPostID() const {return field(m_payload, 0, IDBITS);}
+    int getNumLikes() const {return field(m_payload, LIKESSHIFT, LIKESBITS);}
+    int getConnectLevel() const {return field(m_payload, CONLEVELSHIFT, CONLEVELBITS);}
+    int getPostTime() const {return field(m_payload, TIMESHIFT, TIMEBITS);}
+    int getInterestLevel() const {return field(m_payload, INTERESTSHIFT, INTERESTBITS);}
+    uint64_t getPayload() const {return m_payload;} // All five fields in one word
     void setNPL(int npl) {m_npl = npl;}
     int getNPL() const {return m_npl;}
     // Overloaded insertion operator for Post
     friend ostream& operator<<(ostream& sout, const Post& post);
 
     private:
-    int m_postID;           // every post is identified by a unique ID
-    int m_likes;            // 0-500, constant variables defined for this
-    int m_connectLevel;     // 1-5, constant variables defined for this
-    int m_postTime;         // 1-50, constant variables defined for this
-    int m_interestLevel;    // 1-10, constant variables defined for this
-
-    Post * m_right;   // right child
-    Post * m_left;    // left child
+    // ID (unique per post), likes 0-500, connect level 1-5, post time 1-50 and
+    // interest level 1-10, packed as laid out by the constants above
+    uint64_t m_payload;
+
+    Post * m_right;   // right child (next sibling in a pairing heap)
+    Post * m_left;    // left child (first child in a pairing heap)
+    long long m_key;  // ordering key cached by the queue (the priority, or its decay-adjusted form)
     int m_npl;        // null path length for leftist heap
+    int m_epoch;      // queue epoch at insertion, used by time decay
+
+    static uint64_t pack(int ID, int likes, int connectLevel, int postTime, int interestLevel){
+        return (uint64_t)ID | (uint64_t)likes << LIKESSHIFT | (uint64_t)connectLevel << CONLEVELSHIFT
+             | (uint64_t)postTime << TIMESHIFT | (uint64_t)interestLevel << INTERESTSHIFT;
+    }
+    static int field(uint64_t payload, int shift, int bits){
+        return (int)((payload >> shift) & ((1u << bits) - 1));
+    }
 };
 
 class SQueue{
     public:
     friend class Tester; // for testing purposes
+    friend class TraceRecorder;
+
+    // Forward iterator over the posts in priority order that leaves the heap unchanged.
+    // It keeps a frontier heap of candidate nodes: a node enters the frontier once its
+    // parent was visited, so the first k posts of a skew or leftist heap cost O(k log k)
+    // for any queue size (a pairing heap node adds its whole child list instead).
+    // Any change to the queue invalidates its iterators
+    class const_iterator{
+        public:
+        const Post& operator*() const {return *m_frontier.front();}
+        const Post* operator->() const {return m_frontier.front();}
+        const_iterator& operator++();
+        bool operator==(const const_iterator& rhs) const;
+        bool operator!=(const const_iterator& rhs) const {return !(*this == rhs);}
+
+        private:
+        friend class SQueue;
+        HEAPTYPE m_heapType;            // order of the frontier heap
+        bool m_pairing;                 // right links are siblings, not children
+        vector<const Post*> m_frontier; // candidates, best one at the front
+        void push(const Post* node);
+        bool before(const Post* node1, const Post* node2) const; // frontier heap order
+    };
     
     SQueue(){}
     SQueue(prifn_t priFn, HEAPTYPE heapType, STRUCTURE structure);
+    SQueue(const LinearPriority& model, HEAPTYPE heapType, STRUCTURE structure);
     ~SQueue();
     SQueue(const SQueue& rhs);
     SQueue& operator=(const SQueue& rhs);
     bool insertPost(const Post& post);
+    int insertPosts(const Post posts[], int count); // Bulk insert, returns number of posts inserted
     Post getNextPost(); // Returns the highest priority post
-    void mergeWithQueue(SQueue& rhs);
+    // convert: rhs may differ in structure, heap type, priority and decay; its nodes are
+    // re-keyed and heapified for this queue in O(n) before they are melded in
+    void mergeWithQueue(SQueue& rhs, bool convert = false);
     void clear();
     int numPosts() const; // Returns number of posts in queue
     void printPostsQueue() const; // Print the queue using preorder traversal
     prifn_t getPriorityFn() const;
     void setPriorityFn(prifn_t priFn, HEAPTYPE heapType);
+    void setPriorityModel(const LinearPriority& model, HEAPTYPE heapType);
+    bool hasPriorityModel() const; // true when priorities come from a LinearPriority
     HEAPTYPE getHeapType() const;
-    STRUCTURE getStructure() const;
-    void setStructure(STRUCTURE structure);
+    STRUCTURE getStructure() const; // The structure in use, also for an AUTO queue
+    void setStructure(STRUCTURE structure); // AUTO keeps the current structure and starts adapting
+    bool isAdaptive() const; // Whether the structure follows the observed operation mix
+    const vector<StructureChange>& getStructureChanges() const; // Decisions of an AUTO queue
+    void printStructureChanges() const;
+    void setLazyMerge(bool lazy); // Defer merge work until the root is needed
+    bool getLazyMerge() const;
+    Post peekNextPost(); // Returns the highest priority post without removing it
+    // Epochs for a priority to halve (MAXHEAP) or double (MINHEAP); 0 disables.
+    // Negative priorities decay like a priority of 1
+    void setDecay(int halfLife);
+    int getDecay() const;
+    void advanceEpoch(int epochs = 1); // Ages every post in O(1)
+    int getEpoch() const;
+    double decayedPriority(const Post& post) const; // Priority of a queued post at the current epoch
+    void setThreads(int threads); // Threads used by whole-tree operations on large queues
+    int getThreads() const;
+    // Deferred mode: clear() and the destructor hand the nodes to a background
+    // reclaimer thread in O(1) instead of deleting them on the calling thread
+    void setDeferredClear(bool deferred);
+    bool getDeferredClear() const;
+    static void waitForReclaim(); // Waits until the reclaimer has freed everything handed to it
     void dump() const; // For debugging purposes
+    // Writes every post with its priority, in heap (preorder) order; iterative, so
+    // deep trees and long sibling lists are fine
+    void exportPosts(PostSink& sink, EXPORTFORMAT format) const;
+    const_iterator begin() const; // Highest priority post, see const_iterator
+    const_iterator end() const;
 
     private:
     Post * m_heap;          // Pointer to root of the heap
     int m_size;             // Current size of the heap
     prifn_t m_priorFunc;    // Function to compute priority
+    bool m_linear;          // priorities come from m_model instead of m_priorFunc
+    LinearPriority m_model; // declarative priority used when m_linear is set
     HEAPTYPE m_heapType;    // either a MINHEAP or a MAXHEAP
-    STRUCTURE m_structure;  // skew heap or leftist heap
+    STRUCTURE m_structure;  // skew heap, leftist heap, pairing heap or radix heap
+    bool m_lazyMerge;       // meld by linking roots into m_pending
+    vector<Post*> m_pending;// roots melded lazily, not yet consolidated
+    vector< vector< pair<int, Post*> > > m_buckets; // radix heap buckets of (priority, node)
+    int m_radixLast;        // last priority extracted from the radix heap
+    int m_halfLife;         // time decay half-life in epochs, 0 when decay is off
+    int m_epoch;            // current epoch of the queue
+    int m_threads;          // threads for whole-tree operations, 1 runs them serially
+    int m_forkDepth;        // tree depth down to which subtrees are forked onto new threads
+    bool m_deferredClear;   // nodes are freed by the background reclaimer
+    long long m_steps;      // nodes visited by merges and radix redistribution
+
+    // Operation mix of an AUTO queue over the current sampling window
+    struct AdaptWindow{
+        int m_inserts;
+        int m_pops;
+        int m_merges;
+        long long m_mergedNodes;    // posts brought in by the merges
+        int m_breaks;               // MINHEAP inserts below the last popped key
+        long long m_insertSteps;    // steps taken by each kind of operation
+        long long m_popSteps;
+        long long m_mergeSteps;
+    };
+    bool m_adaptive;        // AUTO: the structure follows the observed operation mix
+    AdaptWindow m_window;
+    long long m_lastPopped; // key of the last popped post, to spot monotone consumption
+    long long m_operations; // operations counted since adapting started
+    STRUCTURE m_candidate;  // structure that won the last window
+    int m_votes;            // consecutive windows it won
+    vector<StructureChange> m_changes;
+
+    class Reclaimer;        // background thread freeing the nodes of cleared queues
+    static Reclaimer& reclaimer();
 
-    void dump(Post *pos) const; // helper function for dump
+    void dump(Post *pos, PostSink& sink) const; // helper function for dump
 
-    Post* clearQueue(Post* node);
+    Post* clearQueue(Post* node, int depth = 0);
+    //iterative deletion of a tree without recursion or extra memory
+    static void deleteTree(Post* node);
     //function to make a deep copy
-    Post* copyTree( Post* node);
+    Post* copyTree( Post* node, int depth = 0);
+    //whether the children of node are processed on separate threads
+    bool forkAt(const Post* node, int depth) const;
+
+    //priority of a post from the function or the linear model
+    int priority(const Post& post) const;
+    //priorities of count posts, evaluated in SIMD batches for a linear model
+    void evaluate(const Post* const posts[], int count, int priorities[]) const;
+    //rebuilds the heap of the current structure after its keys changed
+    void rebuild();
+
+    //ordering key of a priority inserted at a given epoch
+    long long makeKey(int priority, int epoch) const;
+    //recomputes the cached key of every node of a tree
+    void refreshKeys(Post* root);
 
     //merge function for a leftist Heap
     Post* mergeLeftist (Post* root, Post* node);
     //merge function for a skew Heap
     Post* mergeSkew(Post* root, Post* node);
+    //merge function for a pairing Heap
+    Post* mergePairing(Post* root, Post* node);
+    //two-pass pairing of a sibling list into a single pairing heap
+    Post* pairChildren(Post* first);
+    //merge function for the current structure
+    Post* merge(Post* root, Post* node);
+    //pairwise merge of the pending roots into m_heap
+    void consolidate();
+    //pairwise merge of detached heaps into one
+    Post* mergeRounds(vector<Post*>& roots);
+
+    //radix heap helpers
+    int radixBucket(int key) const;
+    void radixPush(Post* node, int key);
+    void radixSettle(); // moves the entries with the minimum priority into bucket 0
+    //detaches every node of a tree (or of the radix buckets) into nodes
+    void collectNodes(Post* root, vector<Post*>& nodes);
+    void collectRadix(vector<Post*>& nodes);
 
     //swapping function
     void swap(Post* &node1, Post* &node2);
 
-    //preorder print of the tree
-    void preorderPrint(Post* root)const;
+    //preorder export of the tree; first is cleared after the first post
+    void exportTree(Post* root, PostSink& sink, EXPORTFORMAT format, bool& first) const;
+
+    //AUTO mode: counts an operation and re-evaluates the structure at the end of a window
+    void countOperation(int operations = 1);
+    void adaptStructure();
+    void resetWindow();
+    //modelled steps of an insert, a pop and a merge on a structure
+    void modelSteps(STRUCTURE structure, double& insert, double& pop, double& merge) const;
+    //cost of the window's operations from their steps on a structure
+    double cost(STRUCTURE structure, double insertSteps, double popSteps, double mergeSteps) const;
+    static double calibrate(double measured, double modelled);
+    //AUTO mode: moves to a structure that supports an operation the current one does not
+    void forceStructure(STRUCTURE structure);
+    //merge of a queue with the same properties
+    void meld(SQueue& rhs);
+    //merge of a queue with other properties, re-keying its nodes for this queue
+    void adopt(SQueue& rhs);
+    //moves the epochs and keys of the RHS nodes onto this queue's clock
+    void rebaseEpochs(SQueue& rhs);
+    //converts the heap to another concrete structure
+    void changeStructure(STRUCTURE structure);
 
     //structure change functions
-    Post* switchToLeftist(Post* root);
+    Post* switchToLeftist(Post* root, int depth = 0);
+    //restores the leftist property of one node
+    void fixLeftist(Post* root);
     Post* switchToSkew(Post* root);
+    Post* switchToPairing(Post* root);
+    Post* switchFromPairing(Post* root);
 
     //funtion to restructure heap based on type
     Post* rebuildHeap(Post* root);
@@ -0,0 +1,281 @@
+
+#include "workload.h"
+#include <fstream>
+#include <iterator>
+
+// WorkloadGen constructor: validates the configuration and builds the alias table of the likes
+WorkloadGen::WorkloadGen(const WorkloadConfig& config) : m_config(config) {
+    if (config.m_inserts < 0 || config.m_pops < 0 || config.m_merges < 0 || config.m_reprioritizations < 0 ||
+        config.m_inserts + config.m_pops + config.m_merges + config.m_reprioritizations == 0)
+        throw out_of_range("Invalid operation mix");
+    if (config.m_reprioritizations > 0 && (config.m_baseFn == nullptr || config.m_altFn == nullptr))
+        throw out_of_range("Reprioritizations need a base and a second priority function");
+    if (config.m_time == BURSTYDIST && !(config.m_burstShare > 0 && config.m_burstShare < 1 && config.m_burstLength > 0))
+        throw out_of_range("Invalid bursts");
+    m_state = config.m_seed;
+    m_bursting = false;
+    m_phaseLeft = 0;
+    m_burstTime = MINTIME;
+
+    // Vose's alias table for P(likes = k) proportional to 1 / (k + 1)^skew: every
+    // column holds its own value with probability m_likesProb and its alias otherwise
+    int values = MAXLIKES - MINLIKES + 1;
+    vector<double> scaled(values);
+    double total = 0;
+    for (int k = 0; k < values; k++){
+        scaled[k] = pow(k + 1.0, -config.m_likesSkew);
+        total += scaled[k];
+    }
+    vector<int> small, large;
+    for (int k = 0; k < values; k++){
+        scaled[k] *= values / total;
+        (scaled[k] < 1 ? small : large).push_back(k);
+    }
+    m_likesProb.assign(values, 1.0);
+    m_likesAlias.assign(values, 0);
+    while (!small.empty() && !large.empty()){
+        int column = small.back();
+        int donor = large.back();
+        small.pop_back();
+        m_likesProb[column] = scaled[column];
+        m_likesAlias[column] = donor;
+        scaled[donor] -= 1 - scaled[column];
+        if (scaled[donor] < 1){
+            large.pop_back();
+            small.push_back(donor);
+        }
+    }
+}
+
+// Returns a post with its fields drawn from the configured distributions
+Post WorkloadGen::getPost() {
+    int id = uniform(MINPOSTID, MAXPOSTID);
+    int likes = getLikes();
+    int connectLevel = uniform(MINCONLEVEL, MAXCONLEVEL);
+    int postTime = getTime();
+    return Post(id, likes, connectLevel, postTime, uniform(MININTERESTLEVEL, MAXINTERESTLEVEL));
+}
+
+// Returns an operation drawn with the configured weights
+OPERATION WorkloadGen::getOperation() {
+    int draw = uniform(0, m_config.m_inserts + m_config.m_pops + m_config.m_merges + m_config.m_reprioritizations - 1);
+    if ((draw -= m_config.m_inserts) < 0)
+        return INSERTOP;
+    if ((draw -= m_config.m_pops) < 0)
+        return POPOP;
+    if ((draw -= m_config.m_merges) < 0)
+        return MERGEOP;
+    return REPRIORITIZEOP;
+}
+
+// Applies count generated operations to a queue driven by a priority function
+uint64_t WorkloadGen::run(SQueue& queue, int count) {
+    uint64_t checksum = 0;
+    for (int i = 0; i < count; i++){
+        OPERATION operation = getOperation();
+        if (operation == INSERTOP)
+            queue.insertPost(getPost());
+        else if (operation == POPOP){
+            if (queue.numPosts() > 0)
+                checksum = checksum * 31 + queue.getNextPost().getPostID();
+        }
+        else if (operation == MERGEOP){
+            SQueue batch(queue.getPriorityFn(), queue.getHeapType(), queue.getStructure());
+            for (int j = 0; j < m_config.m_mergeSize; j++)
+                batch.insertPost(getPost());
+            queue.mergeWithQueue(batch);
+        }
+        else if (queue.getPriorityFn() == m_config.m_altFn && queue.getHeapType() == m_config.m_altHeapType)
+            queue.setPriorityFn(m_config.m_baseFn, m_config.m_baseHeapType);
+        else
+            queue.setPriorityFn(m_config.m_altFn, m_config.m_altHeapType);
+    }
+    return checksum;
+}
+
+// Next value of the splitmix64 stream
+uint64_t WorkloadGen::next() {
+    uint64_t z = (m_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// Uniform integer in [min, max], by scaling 32 random bits instead of a division
+int WorkloadGen::uniform(int min, int max) {
+    return min + (int)(((next() >> 32) * (uint64_t)(max - min + 1)) >> 32);
+}
+
+// Likes, uniform or Zipf: one draw picks an alias table column and decides between its two values
+int WorkloadGen::getLikes() {
+    if (m_config.m_likes != ZIPFDIST)
+        return uniform(MINLIKES, MAXLIKES);
+    uint64_t draw = next();
+    int column = (int)(((draw >> 32) * m_likesProb.size()) >> 32);
+    double coin = (draw & 0xffffffffULL) / 4294967296.0;
+    return MINLIKES + (coin < m_likesProb[column] ? column : m_likesAlias[column]);
+}
+
+// Post time, uniform or bursty: calm phases draw it uniformly, bursts cluster it
+// within one of a random moment. Phase lengths are random around their means,
+// which give bursts m_burstShare of the posts
+int WorkloadGen::getTime() {
+    if (m_config.m_time != BURSTYDIST)
+        return uniform(MINTIME, MAXTIME);
+    if (m_phaseLeft == 0){
+        m_bursting = !m_bursting;
+        double mean = m_config.m_burstLength;
+        if (!m_bursting)
+            mean *= (1 - m_config.m_burstShare) / m_config.m_burstShare;
+        m_phaseLeft = 1 + uniform(0, (int)(2 * mean));
+        if (m_bursting)
+            m_burstTime = uniform(MINTIME, MAXTIME);
+    }
+    m_phaseLeft--;
+    if (!m_bursting)
+        return uniform(MINTIME, MAXTIME);
+    return max(MINTIME, min(MAXTIME, m_burstTime + uniform(-1, 1)));
+}
+
+// Reads a varint of a trace, see TraceRecorder::writeVarint
+static uint64_t readVarint(const vector<char>& bytes, size_t& position) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7){
+        if (position >= bytes.size())
+            throw runtime_error("Corrupt trace");
+        unsigned char byte = (unsigned char)bytes[position++];
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if (byte < 0x80)
+            return value;
+    }
+    throw runtime_error("Corrupt trace");
+}
+
+// Reads a whole trace and decodes it, checking that every call refers to a live
+// queue and to a priority function that was given
+TraceReplayer::TraceReplayer(const string& path, const vector<prifn_t>& functions) : m_functions(functions) {
+    ifstream in(path, ios::binary);
+    if (!in)
+        throw runtime_error("Cannot open trace " + path);
+    vector<char> bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    if (bytes.size() < sizeof(TRACEMAGIC) || !equal(TRACEMAGIC, TRACEMAGIC + sizeof(TRACEMAGIC), bytes.begin()))
+        throw runtime_error("Not a trace: " + path);
+
+    m_queues = 0;
+    m_failures = 0;
+    vector<bool> live;
+    size_t position = sizeof(TRACEMAGIC);
+    while (position < bytes.size()){
+        Record record;
+        record.m_op = (TRACEOP)(unsigned char)bytes[position++];
+        record.m_queue = (unsigned)readVarint(bytes, position);
+        record.m_argument = 0;
+        record.m_more[0] = record.m_more[1] = record.m_more[2] = 0;
+        if (record.m_op < TRACECREATE || record.m_op > TRACEDEFERREDCLEAR)
+            throw runtime_error("Corrupt trace");
+        if (record.m_queue >= live.size())
+            live.resize(record.m_queue + 1, false);
+        // A queue is created by TRACECREATE or TRACECOPY and used until TRACEDESTROY
+        bool creates = (record.m_op == TRACECREATE || record.m_op == TRACECOPY);
+        if (live[record.m_queue] == creates)
+            throw runtime_error("Corrupt trace");
+        live[record.m_queue] = (record.m_op != TRACEDESTROY);
+
+        if (record.m_op == TRACECREATE){
+            record.m_argument = readVarint(bytes, position);
+            for (int i = 0; i < 3; i++)
+                record.m_more[i] = (unsigned)readVarint(bytes, position);
+        }
+        else if (record.m_op == TRACEINSERT){
+            m_posts.push_back(Post(readVarint(bytes, position)));
+            record.m_argument = m_posts.size() - 1;
+        }
+        else if (record.m_op == TRACEINSERTS){
+            record.m_more[0] = (unsigned)readVarint(bytes, position);
+            record.m_argument = m_posts.size();
+            for (unsigned i = 0; i < record.m_more[0]; i++)
+                m_posts.push_back(Post(readVarint(bytes, position)));
+        }
+        else if (record.m_op == TRACEPRIORITYFN){
+            record.m_argument = readVarint(bytes, position);
+            record.m_more[0] = (unsigned)readVarint(bytes, position);
+        }
+        else if (record.m_op == TRACEPRIORITYMODEL){
+            record.m_more[0] = (unsigned)readVarint(bytes, position);
+            int values[7];
+            for (int i = 0; i < 7; i++){ // zigzag encoded, see TraceRecorder::writeModel
+                uint32_t value = (uint32_t)readVarint(bytes, position);
+                values[i] = (int)(value >> 1) ^ -(int)(value & 1);
+            }
+            m_models.push_back(LinearPriority(values[0], values[1], values[2], values[3], values[4], values[5], values[6]));
+            record.m_argument = m_models.size() - 1;
+        }
+        else if (record.m_op != TRACEPOP && record.m_op != TRACECLEAR && record.m_op != TRACEDESTROY)
+            record.m_argument = readVarint(bytes, position);
+
+        if ((record.m_op == TRACECREATE || record.m_op == TRACEPRIORITYFN) && record.m_argument >= m_functions.size())
+            throw runtime_error("Trace needs more priority functions");
+        // The other queue of a copy, an assignment or a merge must be live
+        if ((record.m_op == TRACECOPY || record.m_op == TRACEASSIGN || record.m_op == TRACEMERGE ||
+             record.m_op == TRACEMERGECONVERT) &&
+            (record.m_argument >= live.size() || !live[record.m_argument]))
+            throw runtime_error("Corrupt trace");
+        m_queues = max(m_queues, record.m_queue + 1);
+        m_records.push_back(record);
+    }
+}
+
+// Runs every call on new queues, deleted at the end
+uint64_t TraceReplayer::replay() {
+    vector<SQueue*> queues(m_queues, nullptr);
+    uint64_t checksum = 0;
+    m_failures = 0;
+    for (size_t i = 0; i < m_records.size(); i++){
+        const Record& record = m_records[i];
+        SQueue*& queue = queues[record.m_queue];
+        try{
+            switch (record.m_op){
+                case TRACECREATE:
+                    queue = new SQueue(m_functions[record.m_argument], (HEAPTYPE)record.m_more[0], (STRUCTURE)record.m_more[1]);
+                    if (record.m_more[2] != 0)
+                        queue->setDecay((int)record.m_more[2]);
+                    break;
+                case TRACECOPY: queue = new SQueue(*queues[record.m_argument]); break;
+                case TRACEASSIGN: *queue = *queues[record.m_argument]; break;
+                case TRACEDESTROY: delete queue; queue = nullptr; break;
+                case TRACEINSERT: queue->insertPost(m_posts[record.m_argument]); break;
+                case TRACEINSERTS: queue->insertPosts(&m_posts[record.m_argument], (int)record.m_more[0]); break;
+                case TRACEPOP: checksum = checksum * 31 + queue->getNextPost().getPostID(); break;
+                case TRACEMERGE: queue->mergeWithQueue(*queues[record.m_argument]); break;
+                case TRACEMERGECONVERT: queue->mergeWithQueue(*queues[record.m_argument], true); break;
+                case TRACECLEAR: queue->clear(); break;
+                case TRACEPRIORITYFN: queue->setPriorityFn(m_functions[record.m_argument], (HEAPTYPE)record.m_more[0]); break;
+                case TRACESTRUCTURE: queue->setStructure((STRUCTURE)record.m_argument); break;
+                case TRACEDECAY: queue->setDecay((int)record.m_argument); break;
+                case TRACEEPOCH: queue->advanceEpoch((int)record.m_argument); break;
+                case TRACEPRIORITYMODEL: queue->setPriorityModel(m_models[record.m_argument], (HEAPTYPE)record.m_more[0]); break;
+                case TRACELAZYMERGE: queue->setLazyMerge(record.m_argument != 0); break;
+                case TRACETHREADS: queue->setThreads((int)record.m_argument); break;
+                case TRACEDEFERREDCLEAR: queue->setDeferredClear(record.m_argument != 0); break;
+            }
+        }
+        catch (exception&){ // The call threw when it was recorded as well
+            m_failures++;
+        }
+    }
+    for (size_t i = 0; i < queues.size(); i++)
+        delete queues[i];
+    return checksum;
+}
+
+long long TraceReplayer::numRecords() const {
+    return (long long)m_records.size();
+}
+
+int TraceReplayer::numFailures() const {
+    return m_failures;
+}
+
+int TraceReplayer::numQueues() const {
+    return (int)m_queues;
+}
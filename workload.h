@@ -0,0 +1,216 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+#include "squeue.h"
+#include <cmath>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Enum to define different types of random number distributions
+enum RANDOM {UNIFORMINT, UNIFORMREAL, NORMAL, SHUFFLE};
+
+// Random class for generating various types of random numbers and sequences
+class Random {
+public:
+    Random(){} // Default constructor
+
+    // Constructor to initialize the random number generator with specific parameters
+    Random(int min, int max, RANDOM type=UNIFORMINT, int mean=50, int stdev=20) : m_min(min), m_max(max), m_type(type)
+    {
+        if (type == NORMAL){
+            // Initialize for normal distribution to generate integer numbers
+            m_generator = std::mt19937(m_device()); // Uses a non-deterministic seed from hardware
+            m_normdist = std::normal_distribution<>(mean,stdev);
+        }
+        else if (type == UNIFORMINT) {
+            // Initialize for uniform integer distribution
+            m_generator = std::mt19937(10); // 10 is the fixed seed value for reproducibility
+            m_unidist = std::uniform_int_distribution<>(min,max);
+        }
+        else if (type == UNIFORMREAL) { // For generating real numbers with uniform distribution
+            m_generator = std::mt19937(10); // 10 is the fixed seed value
+            m_uniReal = std::uniform_real_distribution<double>((double)min,(double)max);
+        }
+        else { // For shuffling, generates every number only once
+            m_generator = std::mt19937(m_device()); // Uses a non-deterministic seed
+        }
+    }
+
+    // Allows setting a custom seed for the random number generator
+    void setSeed(int seedNum){
+        m_generator = std::mt19937(seedNum);
+    }
+
+    // Initializes the random generator for uniform integer distribution with new min/max
+    void init(int min, int max){
+        m_min = min;
+        m_max = max;
+        m_type = UNIFORMINT;
+        m_generator = std::mt19937(10); // 10 is the fixed seed value
+        m_unidist = std::uniform_int_distribution<>(min,max);
+    }
+
+    // Populates a vector with numbers from min to max and shuffles them
+    void getShuffle(vector<int> & array){
+        for (int i = m_min; i<=m_max; i++){
+            array.push_back(i);
+        }
+        shuffle(array.begin(),array.end(),m_generator); // Randomly shuffles the elements
+    }
+
+    // Populates an array with numbers from min to max and shuffles them
+    void getShuffle(int array[]){
+        vector<int> temp;
+        for (int i = m_min; i<=m_max; i++){
+            temp.push_back(i);
+        }
+        std::shuffle(temp.begin(), temp.end(), m_generator); // Randomly shuffles the elements
+        vector<int>::iterator it;
+        int i = 0;
+        for (it=temp.begin(); it != temp.end(); it++){
+            array[i] = *it;
+            i++;
+        }
+    }
+
+    // Generates a random integer based on the selected distribution type
+    int getRandNum(){
+        int result = 0;
+        if(m_type == NORMAL){
+            // Returns a random number from a normal distribution, constrained by min and max
+            result = m_min - 1; // Initialize to an invalid value to ensure loop runs
+            while(result < m_min || result > m_max)
+                result = m_normdist(m_generator);
+        }
+        else if (m_type == UNIFORMINT){
+            // Generates a random integer between min and max values
+            result = m_unidist(m_generator);
+        }
+        return result;
+    }
+
+    // Generates a random real number, rounded to two decimal places
+    double getRealRandNum(){
+        double result = m_uniReal(m_generator);
+        result = std::floor(result*100.0)/100.0; // Rounds down to two decimal places
+        return result;
+    }
+
+    // Generates a random string of a specified length
+    string getRandString(int size){
+        string output = "";
+        for (int i=0;i<size;i++){
+            output = output + (char)getRandNum(); // Appends random ASCII characters
+        }
+        return output;
+    }
+    
+    // Getter for minimum value
+    int getMin(){return m_min;}
+    // Getter for maximum value
+    int getMax(){return m_max;}
+private:
+    int m_min; // Minimum value for random generation
+    int m_max; // Maximum value for random generation
+    RANDOM m_type; // Type of random distribution
+    std::random_device m_device; // Non-deterministic random number generator source
+    std::mt19937 m_generator; // Mersenne Twister pseudo-random number generator
+    std::normal_distribution<> m_normdist; // Normal distribution object
+    std::uniform_int_distribution<> m_unidist; // Integer uniform distribution object
+    std::uniform_real_distribution<double> m_uniReal; // Real uniform distribution object
+
+};
+
+// Distributions of the generated Post fields
+enum DISTRIBUTION {UNIFORMDIST, ZIPFDIST, BURSTYDIST};
+// Operations of a generated workload
+enum OPERATION {INSERTOP, POPOP, MERGEOP, REPRIORITIZEOP};
+
+// Shape of a generated workload: field distributions and the operation mix
+struct WorkloadConfig{
+    WorkloadConfig(){
+        m_likes = UNIFORMDIST; m_likesSkew = 1.0;
+        m_time = UNIFORMDIST; m_burstShare = 0.5; m_burstLength = 1000;
+        m_inserts = 1; m_pops = 1; m_merges = 0; m_reprioritizations = 0;
+        m_mergeSize = 8; m_baseFn = nullptr; m_baseHeapType = MAXHEAP; m_altFn = nullptr; m_altHeapType = MINHEAP;
+        m_seed = 10;
+    }
+    DISTRIBUTION m_likes;       // UNIFORMDIST or ZIPFDIST (most posts have few likes)
+    double m_likesSkew;         // Zipf exponent
+    DISTRIBUTION m_time;        // UNIFORMDIST or BURSTYDIST (posts cluster around a moment)
+    double m_burstShare;        // fraction of the posts that arrive in bursts
+    int m_burstLength;          // mean posts per burst
+    int m_inserts;              // relative weights of the operations
+    int m_pops;
+    int m_merges;
+    int m_reprioritizations;
+    int m_mergeSize;            // posts of the queue melded in by a merge
+    prifn_t m_baseFn;           // a reprioritization switches between this function and m_altFn:
+    HEAPTYPE m_baseHeapType;    // to m_altFn unless the queue is on it, back to m_baseFn otherwise
+    prifn_t m_altFn;
+    HEAPTYPE m_altHeapType;
+    uint64_t m_seed;
+};
+
+// Fast generator of posts and operations following a WorkloadConfig. It draws
+// from a splitmix64 stream (much cheaper than mt19937 with std distributions)
+// and samples Zipf likes from an alias table, so a post costs a few multiplies
+class WorkloadGen{
+    public:
+    WorkloadGen(const WorkloadConfig& config);
+    Post getPost();
+    OPERATION getOperation();
+    // Applies count generated operations to a queue: pops of an empty queue are
+    // skipped, merges meld in a new queue of m_mergeSize posts, and reprioritizations
+    // switch between m_baseFn and m_altFn. Returns a checksum of the popped posts
+    uint64_t run(SQueue& queue, int count);
+
+    private:
+    WorkloadConfig m_config;
+    uint64_t m_state;           // splitmix64 state
+    vector<double> m_likesProb; // alias table of the Zipf likes
+    vector<int> m_likesAlias;
+    bool m_bursting;            // the time field follows a burst
+    int m_phaseLeft;            // posts until the phase changes
+    int m_burstTime;            // post time the current burst clusters around
+
+    uint64_t next();
+    int uniform(int min, int max);
+    int getLikes();
+    int getTime();
+};
+
+// Replays a trace written by TraceRecorder (squeue.h) on new queues, without the
+// decoding in the timed loop: the whole trace is decoded into records first.
+// Calls that threw while recording throw again and are counted
+class TraceReplayer{
+    public:
+    // Reads and decodes a trace; functions are the priority functions by their
+    // number in the trace, as returned by TraceRecorder::getFunctions()
+    TraceReplayer(const string& path, const vector<prifn_t>& functions);
+    uint64_t replay(); // Runs the calls at full speed; returns a checksum of the popped posts
+    long long numRecords() const;
+    int numFailures() const; // Calls of the last replay that threw
+    int numQueues() const;
+
+    private:
+    // A decoded call: its main argument (a queue, function, model or post number,
+    // a structure, ...) and up to three small ones (TRACECREATE: heap type, structure
+    // and half-life; TRACEPRIORITYFN and TRACEPRIORITYMODEL: heap type;
+    // TRACEINSERTS: post count)
+    struct Record{
+        TRACEOP m_op;
+        unsigned m_queue;
+        uint64_t m_argument;
+        unsigned m_more[3];
+    };
+    vector<Record> m_records;
+    vector<Post> m_posts;       // posts of the inserts, in trace order
+    vector<LinearPriority> m_models; // models of the TRACEPRIORITYMODEL calls, in trace order
+    vector<prifn_t> m_functions;
+    unsigned m_queues;          // queues numbered in the trace
+    int m_failures;
+};
+#endif